@@ -19,6 +19,8 @@
 #include "iso8601.h"
 #include "internal.h"
 
+#include <errno.h>
+
 void iso8601_add_years(iso8601_time *time, int years)
 {
     time->year += years;
@@ -107,3 +109,201 @@ void iso8601_add_useconds(iso8601_time *time, int useconds)
     iso8601_add_seconds(time, useconds / 1000000);
     time->usecond = useconds % 1000000;
 }
+
+/* Compute base + num * times, failing on overflow. */
+static bool scale_add(int64_t base, int64_t num, int64_t times, int64_t *out)
+{
+    int64_t val;
+
+    return !__builtin_mul_overflow(num, times, &val) &&
+           !__builtin_add_overflow(base, val, out);
+}
+
+/*
+ * Add a duration to the time the given number of times (negative to
+ * subtract), as if the duration's components were multiplied first.
+ */
+static int add_times(iso8601_time *time, const iso8601_duration *duration,
+                     int64_t times)
+{
+    int64_t seconds;
+    int64_t months;
+    int64_t nanos;
+    int64_t years;
+    int64_t days;
+    int32_t year;
+    uint8_t month;
+    uint8_t day;
+
+    if (duration->useconds > 999999 || duration->nseconds > 999)
+        return EINVAL;
+
+    if (duration->negative && __builtin_sub_overflow(0, times, &times))
+        return ERANGE;
+
+    /* Add the nominal components, leaving the day as it is. */
+    if (!scale_add((int64_t) time->year * 12 + time->month - 1,
+                   (int64_t) duration->years * 12 + duration->months,
+                   times, &months))
+        return ERANGE;
+    years = floor_div(months, 12, &months);
+    if (years < INT32_MIN || years > INT32_MAX)
+        return ERANGE;
+
+    /* Add the exact components relative to the start of the month. */
+    if (!scale_add(days_from_civil(years, months + 1, 1) + time->day - 1,
+                   (int64_t) duration->weeks * 7 + duration->days,
+                   times, &days) ||
+        !scale_add(time->hour * 3600 + time->minute * 60 + time->second,
+                   (int64_t) duration->hours * 3600 +
+                   (int64_t) duration->minutes * 60 + duration->seconds,
+                   times, &seconds) ||
+        !scale_add((int64_t) time->usecond * 1000 + time->nsecond,
+                   (int64_t) duration->useconds * 1000 + duration->nseconds,
+                   times, &nanos))
+        return ERANGE;
+
+    /* Normalize everything at once. */
+    if (__builtin_add_overflow(seconds, floor_div(nanos, 1000000000, &nanos),
+                               &seconds) ||
+        __builtin_add_overflow(days, floor_div(seconds, 86400, &seconds),
+                               &days))
+        return ERANGE;
+
+    /* Far outside of the years we can hold, the conversion would overflow. */
+    if (days / 366 < INT32_MIN || days / 366 > INT32_MAX ||
+        !civil_from_days(days, &year, &month, &day))
+        return ERANGE;
+
+    time->year = year;
+    time->month = month;
+    time->day = day;
+    time->hour = seconds / 3600;
+    time->minute = seconds / 60 % 60;
+    time->second = seconds % 60;
+    time->usecond = nanos / 1000;
+    time->nsecond = nanos % 1000;
+    return 0;
+}
+
+int iso8601_add_duration(iso8601_time *time, const iso8601_duration *duration)
+{
+    if (time == NULL || duration == NULL)
+        return EINVAL;
+
+    return add_times(time, duration, 1);
+}
+
+/* Whether a duration moves time forwards. */
+static bool is_positive(const iso8601_duration *d)
+{
+    return !d->negative &&
+           (d->years | d->months | d->weeks | d->days | d->hours |
+            d->minutes | d->seconds | d->useconds | d->nseconds) != 0;
+}
+
+/* The number of occurrences which may be returned. */
+static int64_t recurrence_limit(const iso8601_recurrence *recurrence)
+{
+    return recurrence->count < 0 ? INT64_MAX : recurrence->count;
+}
+
+/*
+ * Get an occurrence in microseconds since the epoch. Occurrences which don't
+ * fit saturate, which keeps the sequence ordered.
+ */
+static int64_t occurrence_us(const iso8601_recurrence *recurrence,
+                             int64_t index)
+{
+    iso8601_time time = recurrence->start;
+    int64_t seconds;
+    int64_t us;
+
+    if (add_times(&time, &recurrence->period, index) != 0)
+        return INT64_MAX;
+
+    seconds = days_from_civil(time.year, time.month, time.day) * 86400 +
+              time.hour * 3600 + (time.minute - recurrence->tzminutes) * 60 +
+              time.second;
+    if (__builtin_mul_overflow(seconds, 1000000, &us) ||
+        __builtin_add_overflow(us, time.usecond, &us))
+        return seconds < 0 ? INT64_MIN : INT64_MAX;
+
+    return us;
+}
+
+/*
+ * Estimate the index of the first occurrence at or after us. Exact periods
+ * divide exactly, up to the nanoseconds dropped from the start. Otherwise,
+ * months are taken at their average length.
+ */
+static int64_t estimate(const iso8601_recurrence *recurrence, int64_t us)
+{
+    const iso8601_duration *p = &recurrence->period;
+    const int64_t start = occurrence_us(recurrence, 0);
+    int64_t period;
+    int64_t delta;
+    double index;
+
+    if (us <= start)
+        return 0;
+
+    if (p->years == 0 && p->months == 0 &&
+        !__builtin_sub_overflow(us, start, &delta) &&
+        scale_add(p->useconds * 1000 + p->nseconds, 1000000000,
+                  (int64_t) p->weeks * 604800 + (int64_t) p->days * 86400 +
+                  (int64_t) p->hours * 3600 + (int64_t) p->minutes * 60 +
+                  p->seconds, &period) &&
+        !__builtin_mul_overflow(delta, 1000, &delta))
+        return delta / period + (delta % period != 0);
+
+    index = ((double) us - start) / 1000000 /
+            (p->years * 31556952.0 + p->months * 2629746.0 +
+             p->weeks * 604800.0 + p->days * 86400.0 + p->hours * 3600.0 +
+             p->minutes * 60.0 + p->seconds + p->useconds / 1e6 +
+             p->nseconds / 1e9);
+    return index < (double) INT64_MAX ? (int64_t) index : INT64_MAX;
+}
+
+int iso8601_recurrence_next(iso8601_recurrence *recurrence, iso8601_time *out)
+{
+    iso8601_time time;
+
+    if (recurrence == NULL || out == NULL)
+        return EINVAL;
+
+    if (recurrence->next < 0 ||
+        recurrence->next >= recurrence_limit(recurrence))
+        return ENOENT;
+
+    time = recurrence->start;
+    if (add_times(&time, &recurrence->period, recurrence->next) != 0)
+        return ENOENT;
+
+    recurrence->next++;
+    *out = time;
+    return 0;
+}
+
+int iso8601_recurrence_seek(iso8601_recurrence *recurrence, int64_t us)
+{
+    int64_t index;
+    int64_t limit;
+
+    if (recurrence == NULL || !is_positive(&recurrence->period))
+        return EINVAL;
+
+    limit = recurrence_limit(recurrence);
+    index = estimate(recurrence, us);
+    if (index > limit)
+        index = limit;
+
+    /* The estimate is off by at most a few occurrences. */
+    while (index > 0 && occurrence_us(recurrence, index - 1) >= us)
+        index--;
+    while (index < limit && occurrence_us(recurrence, index) < us)
+        index++;
+
+    recurrence->next = index;
+    return index < limit ? 0 : ENOENT;
+}
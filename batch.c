@@ -0,0 +1,378 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/**
+ * Copyright: 2013 Red Hat, Inc.
+ * Author: Nathaniel McCallum <npmccallum@redhat.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iso8601.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Elements per chunk. A chunk of parsed times plus its input pointers and
+ * lengths stays well within a typical 32KiB L1 data cache.
+ */
+#define CHUNK 512
+
+/*
+ * The chunks still owned by a worker, packed as (next << 32) | end so that
+ * the owner, taking from the front, and thieves, taking from the back, can
+ * never both take the last chunk. Each range has a cache line to itself.
+ */
+struct range {
+    _Alignas(64) _Atomic uint64_t span;
+};
+
+struct batch {
+    size_t n;
+    size_t chunk;
+    size_t workers;
+    struct range *ranges;
+    atomic_bool failed;
+
+    /* Process elements [begin, end). Returns false if any of them failed. */
+    bool (*run)(const struct batch *batch, size_t begin, size_t end);
+
+    /* The job itself. */
+    const char *const *in;
+    const size_t *lens;
+    iso8601_time *times;
+    const iso8601_time *ctimes;
+    uint32_t flags;
+    uint8_t ydigits;
+    iso8601_format format;
+    iso8601_truncate truncate;
+    size_t len;
+    char *out;
+    int *status;
+};
+
+/* Take a chunk from the front of a range, or from the back when stealing. */
+static bool take(struct range *range, bool steal, uint32_t *chunk)
+{
+    uint64_t span = atomic_load_explicit(&range->span, memory_order_relaxed);
+
+    for (;;) {
+        const uint32_t next = span >> 32;
+        const uint32_t end = span;
+        const uint64_t rest = steal ? span - 1 : span + ((uint64_t) 1 << 32);
+
+        if (next >= end)
+            return false;
+
+        if (atomic_compare_exchange_weak_explicit(&range->span, &span, rest,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+            *chunk = steal ? end - 1 : next;
+            return true;
+        }
+    }
+}
+
+static void run_chunk(struct batch *batch, uint32_t chunk)
+{
+    const size_t begin = chunk * batch->chunk;
+    const size_t end = begin + batch->chunk < batch->n ?
+                       begin + batch->chunk : batch->n;
+
+    if (!batch->run(batch, begin, end))
+        atomic_store_explicit(&batch->failed, true, memory_order_relaxed);
+}
+
+/*
+ * Work through our own chunks, then steal from the others until none are
+ * left. Chunks are never added, so one empty pass means we're done.
+ */
+static void work(void *arg, size_t worker)
+{
+    struct batch *batch = arg;
+    bool stole = true;
+    uint32_t chunk;
+
+    while (take(&batch->ranges[worker], false, &chunk))
+        run_chunk(batch, chunk);
+
+    while (stole) {
+        stole = false;
+
+        for (size_t i = 1; i < batch->workers; i++) {
+            const size_t other = (worker + i) % batch->workers;
+            struct range *victim = &batch->ranges[other];
+
+            while (take(victim, true, &chunk)) {
+                run_chunk(batch, chunk);
+                stole = true;
+            }
+        }
+    }
+}
+
+/*
+ * The threads which run batches given no executor. They are started as the
+ * first batches need them and then kept for the life of the process, so that
+ * a batch only has to wake them. One batch runs on them at a time.
+ */
+static struct {
+    pthread_mutex_t busy;  /* Held by the caller running a batch. */
+    pthread_mutex_t lock;  /* Protects everything below. */
+    pthread_cond_t wake;   /* Signalled when there are workers to run. */
+    pthread_cond_t done;   /* Signalled when the last worker returns. */
+    size_t threads;        /* The threads started so far. */
+    size_t next;           /* The next worker to run. */
+    size_t workers;        /* The workers of the current batch. */
+    size_t running;        /* The workers which haven't yet returned. */
+    void (*task)(void *arg, size_t worker);
+    void *arg;
+} pool = {
+    .busy = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+/* Run the next worker of the current batch, if any. pool.lock is held. */
+static bool run_next(void)
+{
+    void (*task)(void *arg, size_t worker) = pool.task;
+    void *arg = pool.arg;
+    size_t worker;
+
+    if (pool.next >= pool.workers)
+        return false;
+
+    worker = pool.next++;
+    pthread_mutex_unlock(&pool.lock);
+    task(arg, worker);
+    pthread_mutex_lock(&pool.lock);
+
+    if (--pool.running == 0)
+        pthread_cond_signal(&pool.done);
+    return true;
+}
+
+static void *pool_main(void *arg)
+{
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        if (!run_next())
+            pthread_cond_wait(&pool.wake, &pool.lock);
+    }
+
+    return NULL;
+}
+
+/*
+ * Only the forking thread survives a fork, so the child forgets the threads
+ * and the waits they were in. The pool is locked across the fork to leave
+ * it consistent.
+ */
+static void pool_prepare(void)
+{
+    pthread_mutex_lock(&pool.lock);
+}
+
+static void pool_parent(void)
+{
+    pthread_mutex_unlock(&pool.lock);
+}
+
+static void pool_child(void)
+{
+    pool.threads = 0;
+    pool.next = pool.workers = pool.running = 0;
+    pthread_cond_init(&pool.wake, NULL);
+    pthread_cond_init(&pool.done, NULL);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+static void pool_init(void)
+{
+    pthread_atfork(pool_prepare, pool_parent, pool_child);
+}
+
+/*
+ * Run the workers on the pool, starting any threads it still lacks. The
+ * caller runs worker 0 and then any workers which no thread has taken, so
+ * the batch completes even if no thread can be started. While another batch
+ * holds the pool, the caller runs alone; its worker steals every chunk.
+ */
+static void execute(void *ctx, size_t workers,
+                    void (*task)(void *arg, size_t worker), void *arg)
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+    pthread_once(&once, pool_init);
+    if (workers == 1 || pthread_mutex_trylock(&pool.busy) != 0) {
+        task(arg, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.threads < workers - 1) {
+        pthread_attr_t attr;
+        pthread_t thread;
+        int err;
+
+        if (pthread_attr_init(&attr) != 0)
+            break;
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        err = pthread_create(&thread, &attr, pool_main, NULL);
+        pthread_attr_destroy(&attr);
+        if (err != 0)
+            break;
+
+        pool.threads++;
+    }
+
+    pool.task = task;
+    pool.arg = arg;
+    pool.next = 1;
+    pool.workers = workers;
+    pool.running = workers - 1;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    task(arg, 0);
+
+    pthread_mutex_lock(&pool.lock);
+    while (run_next())
+        continue;
+    while (pool.running > 0)
+        pthread_cond_wait(&pool.done, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+
+    pthread_mutex_unlock(&pool.busy);
+}
+
+static int run_batch(struct batch *batch, size_t threads,
+                     iso8601_executor executor, void *ctx)
+{
+    struct range *ranges;
+    size_t chunks;
+
+    if (batch->n == 0)
+        return 0;
+
+    /* Chunk numbers must fit in the 32-bit halves of a range. */
+    batch->chunk = CHUNK;
+    if (batch->n / batch->chunk >= UINT32_MAX)
+        batch->chunk = batch->n / (UINT32_MAX - 1) + 1;
+    chunks = (batch->n + batch->chunk - 1) / batch->chunk;
+
+    if (threads == 0 && executor == NULL) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? cpus : 1;
+    }
+    if (threads == 0)
+        return EINVAL;
+    if (threads > chunks)
+        threads = chunks;
+    if (executor == NULL)
+        executor = execute;
+
+    ranges = aligned_alloc(_Alignof(struct range), threads * sizeof(*ranges));
+    if (ranges == NULL)
+        return ENOMEM;
+
+    /* Deal out the chunks evenly; stealing evens out the rest. */
+    for (size_t i = 0; i < threads; i++) {
+        const uint64_t next = chunks * i / threads;
+        const uint64_t end = chunks * (i + 1) / threads;
+
+        atomic_init(&ranges[i].span, next << 32 | end);
+    }
+
+    batch->workers = threads;
+    batch->ranges = ranges;
+    atomic_init(&batch->failed, false);
+
+    executor(ctx, threads, work, batch);
+    free(ranges);
+    return atomic_load(&batch->failed) ? EINVAL : 0;
+}
+
+static bool run_parse(const struct batch *batch, size_t begin, size_t end)
+{
+    bool ok = true;
+
+    for (size_t i = begin; i < end; i++) {
+        const size_t len = batch->lens != NULL ? batch->lens[i] : SIZE_MAX;
+        int err;
+
+        err = iso8601_parse_n(batch->in[i], len, NULL, &batch->times[i]);
+        if (batch->status != NULL)
+            batch->status[i] = err;
+        ok &= err == 0;
+    }
+
+    return ok;
+}
+
+static bool run_unparse(const struct batch *batch, size_t begin, size_t end)
+{
+    bool ok = true;
+
+    for (size_t i = begin; i < end; i++) {
+        int err;
+
+        err = iso8601_unparse(&batch->ctimes[i], batch->flags, batch->ydigits,
+                              batch->format, batch->truncate, batch->len,
+                              &batch->out[i * batch->len]);
+        if (batch->status != NULL)
+            batch->status[i] = err;
+        ok &= err == 0;
+    }
+
+    return ok;
+}
+
+int iso8601_parse_batch_parallel(const char *const *in, const size_t *lens,
+                                 size_t n, iso8601_time *out, int *status,
+                                 size_t threads, iso8601_executor executor,
+                                 void *ctx)
+{
+    struct batch batch = {
+        .n = n, .run = run_parse,
+        .in = in, .lens = lens, .times = out, .status = status,
+    };
+
+    if (n > 0 && (in == NULL || out == NULL))
+        return EINVAL;
+
+    return run_batch(&batch, threads, executor, ctx);
+}
+
+int iso8601_unparse_batch_parallel(const iso8601_time *in, size_t n,
+                                   uint32_t flags, uint8_t ydigits,
+                                   iso8601_format format,
+                                   iso8601_truncate truncate, size_t len,
+                                   char *out, int *status, size_t threads,
+                                   iso8601_executor executor, void *ctx)
+{
+    struct batch batch = {
+        .n = n, .run = run_unparse,
+        .ctimes = in, .flags = flags, .ydigits = ydigits, .format = format,
+        .truncate = truncate, .len = len, .out = out, .status = status,
+    };
+
+    if (n > 0 && (in == NULL || out == NULL))
+        return EINVAL;
+
+    return run_batch(&batch, threads, executor, ctx);
+}
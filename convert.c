@@ -0,0 +1,545 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/**
+ * Copyright: 2013 Red Hat, Inc.
+ * Author: Nathaniel McCallum <npmccallum@redhat.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * iso8601-convert: rewrite newline-delimited ISO 8601 timestamps in another
+ * format, or as times since the epoch.
+ *
+ * Lines are parsed and unparsed a batch at a time with the parallel batch
+ * functions, whose threads the library keeps from one batch to the next,
+ * and the output is written in large blocks, so there are no system calls
+ * per line. Each input line gives exactly one output line; a
+ * line which can't be converted gives an empty line and is counted as an
+ * error.
+ */
+
+#include "iso8601.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define BATCH 16384         /* Lines per batch. */
+#define SLOT 64             /* Enough for any unparsed time or epoch. */
+#define READ (4 << 20)      /* Bytes per read() when streaming. */
+#define WRITE (4 << 20)     /* Bytes per write(). */
+
+struct options {
+    uint32_t flags;
+    uint8_t ydigits;
+    iso8601_format format;
+    iso8601_truncate truncate;
+    bool epoch;
+    iso8601_unit unit;
+    bool utc;
+    bool zoned;
+    int16_t zone;
+    size_t threads;
+    bool quiet;
+};
+
+struct convert {
+    const struct options *opts;
+
+    /* The current batch. */
+    size_t n;
+    const char *in[BATCH];
+    size_t lens[BATCH];
+    iso8601_time times[BATCH];
+    int status[BATCH];
+    int ustatus[BATCH];
+    char text[BATCH][SLOT];
+
+    /* Buffered output. */
+    size_t used;
+    char out[WRITE];
+
+    uint64_t lines;
+    uint64_t errors;
+    uint64_t bytes;
+};
+
+struct name {
+    const char *name;
+    int value;
+};
+
+static const struct name FORMATS[] = {
+    { "calendar", ISO8601_FORMAT_NORMAL },
+    { "week", ISO8601_FORMAT_WEEKDATE },
+    { "ordinal", ISO8601_FORMAT_ORDINAL },
+    {}
+};
+
+static const struct name TRUNCATIONS[] = {
+    { "none", ISO8601_TRUNCATE_NONE },
+    { "year", ISO8601_TRUNCATE_YEAR },
+    { "month", ISO8601_TRUNCATE_MONTH },
+    { "week", ISO8601_TRUNCATE_WEEK },
+    { "day", ISO8601_TRUNCATE_DAY },
+    { "hour", ISO8601_TRUNCATE_HOUR },
+    { "minute", ISO8601_TRUNCATE_MINUTE },
+    { "second", ISO8601_TRUNCATE_SECOND },
+    {}
+};
+
+static const struct name PRECISIONS[] = {
+    { "milli", ISO8601_FLAG_MILLI },
+    { "micro", ISO8601_FLAG_MICRO },
+    { "nano", ISO8601_FLAG_NANO },
+    {}
+};
+
+static const struct name UNITS[] = {
+    { "s", ISO8601_UNIT_SECOND },
+    { "ms", ISO8601_UNIT_MILLI },
+    { "us", ISO8601_UNIT_MICRO },
+    { "ns", ISO8601_UNIT_NANO },
+    {}
+};
+
+static void usage(FILE *file, const char *argv0)
+{
+    fprintf(file,
+"Usage: %s [OPTIONS] [FILE...]\n"
+"\n"
+"Convert ISO 8601 timestamps, one per line, from the files (or standard\n"
+"input) to standard output. Each line which can't be converted is written\n"
+"as an empty line.\n"
+"\n"
+"  -f FORMAT   calendar (default), week or ordinal\n"
+"  -b          write the basic format instead of the extended format\n"
+"  -t LEVEL    truncate after: year, month, week, day, hour, minute or\n"
+"              second (default: none)\n"
+"  -p UNIT     always write a fraction of milli, micro or nano seconds\n"
+"  -y DIGITS   write the year with 2-9 digits (default: 4)\n"
+"  -u          normalize to UTC\n"
+"  -e UNIT     write the time since the epoch in s, ms, us or ns instead\n"
+"  -z MINUTES  the offset of input without a timezone (for -u and -e)\n"
+"  -j THREADS  the number of threads (default: one per CPU)\n"
+"  -q          don't report throughput and errors on standard error\n"
+"  -h          show this help\n"
+"\n"
+"Exits with 0 if every line was converted, 1 if any line failed and 2 on\n"
+"other errors.\n", argv0);
+}
+
+static bool lookup(const struct name *names, const char *name, int *value)
+{
+    for (size_t i = 0; names[i].name != NULL; i++) {
+        if (strcmp(names[i].name, name) == 0) {
+            *value = names[i].value;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool number(const char *str, long min, long max, long *out)
+{
+    char *end = NULL;
+
+    errno = 0;
+    *out = strtol(str, &end, 10);
+    return errno == 0 && end != str && *end == '\0' &&
+           *out >= min && *out <= max;
+}
+
+static void flush(struct convert *c)
+{
+    size_t done = 0;
+
+    while (done < c->used) {
+        ssize_t ret = write(STDOUT_FILENO, &c->out[done], c->used - done);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0) {
+            fprintf(stderr, "iso8601-convert: write: %s\n", strerror(errno));
+            exit(2);
+        }
+
+        done += ret;
+    }
+
+    c->used = 0;
+}
+
+/* Write an integer without snprintf(); this is the inner loop for -e. */
+static size_t put_int64(int64_t val, char *out)
+{
+    uint64_t mag = val < 0 ? 0 - (uint64_t) val : (uint64_t) val;
+    char tmp[20];
+    size_t len = 0;
+    size_t i = 0;
+
+    do {
+        tmp[i++] = '0' + mag % 10;
+        mag /= 10;
+    } while (mag > 0);
+
+    if (val < 0)
+        out[len++] = '-';
+
+    while (i > 0)
+        out[len++] = tmp[--i];
+
+    return len;
+}
+
+static void put_line(struct convert *c, const char *str, size_t len)
+{
+    if (c->used + len + 1 > sizeof(c->out))
+        flush(c);
+
+    memcpy(&c->out[c->used], str, len);
+    c->used += len;
+    c->out[c->used++] = '\n';
+}
+
+static void convert_epoch(struct convert *c)
+{
+    const struct options *opts = c->opts;
+
+    for (size_t i = 0; i < c->n; i++) {
+        int64_t val;
+
+        c->status[i] = iso8601_parse_epoch(c->in[i], c->lens[i], NULL,
+                                           opts->unit,
+                                           opts->zoned ? &opts->zone : NULL,
+                                           &val);
+        if (c->status[i] == 0)
+            c->lens[i] = put_int64(val, c->text[i]);
+    }
+}
+
+static void to_utc(const struct options *opts, iso8601_time *time, int *status)
+{
+    if (time->localtime) {
+        if (!opts->zoned) {
+            *status = EDOM;
+            return;
+        }
+
+        time->localtime = false;
+        time->tzminutes = opts->zone;
+    }
+
+    iso8601_add_minutes(time, -time->tzminutes);
+    time->tzminutes = 0;
+}
+
+static void convert_times(struct convert *c)
+{
+    const struct options *opts = c->opts;
+    int err;
+
+    /* EINVAL only means that some lines failed; status says which. */
+    err = iso8601_parse_batch_parallel(c->in, c->lens, c->n, c->times,
+                                       c->status, opts->threads, NULL, NULL);
+    if (err == ENOMEM) {
+        fprintf(stderr, "iso8601-convert: %s\n", strerror(err));
+        exit(2);
+    }
+
+    for (size_t i = 0; opts->utc && i < c->n; i++) {
+        if (c->status[i] == 0)
+            to_utc(opts, &c->times[i], &c->status[i]);
+    }
+
+    err = iso8601_unparse_batch_parallel(c->times, c->n, opts->flags,
+                                         opts->ydigits, opts->format,
+                                         opts->truncate, SLOT, &c->text[0][0],
+                                         c->ustatus, opts->threads, NULL,
+                                         NULL);
+    if (err == ENOMEM) {
+        fprintf(stderr, "iso8601-convert: %s\n", strerror(err));
+        exit(2);
+    }
+
+    for (size_t i = 0; i < c->n; i++) {
+        if (c->status[i] == 0)
+            c->status[i] = c->ustatus[i];
+        if (c->status[i] == 0)
+            c->lens[i] = strlen(c->text[i]);
+    }
+}
+
+static void convert_batch(struct convert *c)
+{
+    if (c->n == 0)
+        return;
+
+    if (c->opts->epoch)
+        convert_epoch(c);
+    else
+        convert_times(c);
+
+    for (size_t i = 0; i < c->n; i++) {
+        if (c->status[i] == 0) {
+            put_line(c, c->text[i], c->lens[i]);
+        } else {
+            put_line(c, "", 0);
+            c->errors++;
+        }
+    }
+
+    c->lines += c->n;
+    c->n = 0;
+}
+
+static void add_line(struct convert *c, const char *line, size_t len)
+{
+    if (len > 0 && line[len - 1] == '\r')
+        len--;
+
+    c->in[c->n] = line;
+    c->lens[c->n] = len;
+    if (++c->n == BATCH)
+        convert_batch(c);
+}
+
+/*
+ * Convert all of the complete lines in data, and the last line too if final
+ * is set. Returns the number of bytes consumed. Nothing points into data
+ * afterwards.
+ */
+static size_t feed(struct convert *c, const char *data, size_t len,
+                   bool final)
+{
+    size_t done = 0;
+
+    while (done < len) {
+        const char *nl = memchr(&data[done], '\n', len - done);
+
+        if (nl == NULL) {
+            if (!final)
+                break;
+
+            add_line(c, &data[done], len - done);
+            done = len;
+            break;
+        }
+
+        add_line(c, &data[done], nl - &data[done]);
+        done = nl - data + 1;
+    }
+
+    convert_batch(c);
+    c->bytes += done;
+    return done;
+}
+
+static bool stream(struct convert *c, int fd, char *buf)
+{
+    bool discard = false;
+    size_t have = 0;
+
+    for (;;) {
+        ssize_t ret = read(fd, &buf[have], READ - have);
+        size_t done;
+
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0)
+            return false;
+
+        have += ret;
+
+        /* Skip the rest of a line which was too long for the buffer. */
+        if (discard) {
+            const char *nl = memchr(buf, '\n', have);
+
+            done = nl == NULL ? have : (size_t) (nl - buf + 1);
+            memmove(buf, &buf[done], have - done);
+            c->bytes += done;
+            have -= done;
+            discard = nl == NULL;
+            if (discard && ret > 0)
+                continue;
+        }
+
+        done = feed(c, buf, have, ret == 0);
+        memmove(buf, &buf[done], have - done);
+        have -= done;
+
+        if (ret == 0)
+            return true;
+
+        /* No timestamp is this long: fail the line and skip the rest. */
+        if (have == READ) {
+            put_line(c, "", 0);
+            c->lines++;
+            c->errors++;
+            c->bytes += have;
+            have = 0;
+            discard = true;
+        }
+    }
+}
+
+static bool convert_file(struct convert *c, int fd, char *buf)
+{
+    struct stat st;
+    void *map;
+    bool ok;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+        (uintmax_t) st.st_size > SIZE_MAX)
+        return stream(c, fd, buf);
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        return stream(c, fd, buf);
+
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    ok = feed(c, map, st.st_size, true) == (size_t) st.st_size;
+    munmap(map, st.st_size);
+    return ok;
+}
+
+static double elapsed(const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) +
+           (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    struct options opts = { .ydigits = 4 };
+    struct timespec start;
+    struct convert *c;
+    char *buf;
+    double secs;
+    long val;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:bt:p:y:ue:z:j:qh")) != -1) {
+        int value;
+
+        switch (opt) {
+        case 'f':
+            if (!lookup(FORMATS, optarg, &value))
+                goto usage;
+            opts.format = value;
+            break;
+        case 'b':
+            opts.flags |= ISO8601_FLAG_BASIC;
+            break;
+        case 't':
+            if (!lookup(TRUNCATIONS, optarg, &value))
+                goto usage;
+            opts.truncate = value;
+            break;
+        case 'p':
+            if (!lookup(PRECISIONS, optarg, &value))
+                goto usage;
+            opts.flags &= ISO8601_FLAG_BASIC;
+            opts.flags |= value;
+            break;
+        case 'y':
+            if (!number(optarg, 2, 9, &val))
+                goto usage;
+            opts.ydigits = val;
+            break;
+        case 'u':
+            opts.utc = true;
+            break;
+        case 'e':
+            if (!lookup(UNITS, optarg, &value))
+                goto usage;
+            opts.epoch = true;
+            opts.unit = value;
+            break;
+        case 'z':
+            if (!number(optarg, -24 * 60, 24 * 60, &val))
+                goto usage;
+            opts.zoned = true;
+            opts.zone = val;
+            break;
+        case 'j':
+            if (!number(optarg, 1, 4096, &val))
+                goto usage;
+            opts.threads = val;
+            break;
+        case 'q':
+            opts.quiet = true;
+            break;
+        case 'h':
+            usage(stdout, argv[0]);
+            return 0;
+        default:
+            goto usage;
+        }
+    }
+
+    c = malloc(sizeof(*c));
+    buf = malloc(READ);
+    if (c == NULL || buf == NULL) {
+        fprintf(stderr, "iso8601-convert: %s\n", strerror(ENOMEM));
+        return 2;
+    }
+
+    *c = (struct convert) { .opts = &opts };
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int i = optind; i < argc || i == optind; i++) {
+        const char *path = i < argc ? argv[i] : "-";
+        int fd = STDIN_FILENO;
+
+        if (strcmp(path, "-") != 0)
+            fd = open(path, O_RDONLY);
+
+        if (fd < 0 || !convert_file(c, fd, buf)) {
+            fprintf(stderr, "iso8601-convert: %s: %s\n", path,
+                    strerror(errno));
+            return 2;
+        }
+
+        if (fd != STDIN_FILENO)
+            close(fd);
+    }
+
+    flush(c);
+    secs = elapsed(&start);
+
+    if (!opts.quiet) {
+        fprintf(stderr, "%" PRIu64 " lines, %" PRIu64 " errors, "
+                "%.1f MiB in %.3f s (%.0f lines/s, %.1f MiB/s)\n",
+                c->lines, c->errors, c->bytes / 1048576.0, secs,
+                secs > 0 ? c->lines / secs : 0,
+                secs > 0 ? c->bytes / 1048576.0 / secs : 0);
+    }
+
+    val = c->errors > 0;
+    free(buf);
+    free(c);
+    return val;
+
+usage:
+    usage(stderr, argv[0]);
+    return 2;
+}
@@ -17,9 +17,7 @@
  */
 
 #include "internal.h"
-#include <assert.h>
 #include <string.h>
-#include <time.h>
 
 static bool is_leapyear(int year)
 {
@@ -29,20 +27,54 @@ static bool is_leapyear(int year)
 /* Return the offset from Jan 1 to the start of week 1 (may be negative). */
 static int8_t weekdate_offset(int32_t year)
 {
-    struct tm tmp = { .tm_year = year - 1900, .tm_mday = 1 };
+    /* 1970-01-01 was a Thursday. Sunday is 0. */
+    const int wday = ((days_from_civil(year, 1, 1) + 4) % 7 + 7) % 7;
 
-    /* This should never fail. */
-    assert(mktime(&tmp) != -1);
-
-    switch (tmp.tm_wday) {
+    switch (wday) {
     case 5: /* Friday */
     case 6: /* Saturday */
-        return 8 - tmp.tm_wday;
+        return 8 - wday;
     default:
-        return 1 - tmp.tm_wday;
+        return 1 - wday;
     }
 }
 
+int64_t days_from_civil(int32_t year, uint8_t month, uint8_t day)
+{
+    /* Start the year in March, so that the leap day comes last. */
+    const int64_t y = (int64_t) year - (month <= 2);
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int64_t yoe = y - era * 400;
+    const int64_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5
+                        + day - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    /* Eras of 400 years all have 146097 days. 0000-03-01 is day -719468. */
+    return era * 146097 + doe - 719468;
+}
+
+bool civil_from_days(int64_t days, int32_t *year, uint8_t *month,
+                     uint8_t *day)
+{
+    /* The inverse of days_from_civil(), again starting the year in March. */
+    const int64_t z = days + 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const int64_t doe = z - era * 146097;
+    const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int64_t doy = doe - (yoe * 365 + yoe / 4 - yoe / 100);
+    const int64_t mp = (doy * 5 + 2) / 153;
+    const uint8_t m = mp < 10 ? mp + 3 : mp - 9;
+    const int64_t y = era * 400 + yoe + (m <= 2);
+
+    if (y < INT32_MIN || y > INT32_MAX)
+        return false;
+
+    *year = y;
+    *month = m;
+    *day = doy - (mp * 153 + 2) / 5 + 1;
+    return true;
+}
+
 uint16_t length_year_days(int32_t year)
 {
     return is_leapyear(year) ? 366 : 365;
@@ -18,9 +18,72 @@
 
 #pragma once
 
+#include "iso8601.h"
+
 #include <stdbool.h>
 #include <stdint.h>
 
+/**
+ * Divide, rounding towards negative infinity. The remainder, which is never
+ * negative for a positive den, is stored in *rem.
+ *
+ * @return the quotient
+ */
+static inline int64_t floor_div(int64_t num, int64_t den, int64_t *rem)
+{
+    int64_t quo = num / den;
+
+    *rem = num % den;
+    if (*rem < 0) {
+        *rem += den;
+        quo--;
+    }
+
+    return quo;
+}
+
+/**
+ * Fold hour 24 into the next day and a timezone offset into UTC. Local
+ * times keep their fields, and leap seconds are never normalized.
+ */
+static inline void normalize(iso8601_time *time)
+{
+    iso8601_add_hours(time, 0);
+
+    if (!time->localtime) {
+        iso8601_add_minutes(time, time->tzminutes * -1);
+        time->tzminutes = 0;
+    }
+}
+
+/**
+ * Check whether normalize() would leave the time as it is.
+ *
+ * @return true if the time is already normalized
+ */
+static inline bool is_normalized(const iso8601_time *time)
+{
+    return time->hour < 24 && (time->localtime || time->tzminutes == 0);
+}
+
+/**
+ * Get the number of days from 1970-01-01 to a calendar date.
+ *
+ * The date is not validated and may lie before 1970, in which case the
+ * result is negative.
+ *
+ * @return number of days since the Unix epoch
+ */
+int64_t days_from_civil(int32_t year, uint8_t month, uint8_t day);
+
+/**
+ * Convert a number of days since 1970-01-01 into a calendar date.
+ *
+ * @return true on success; false if the year doesn't fit
+ */
+bool civil_from_days(int64_t days, int32_t *year, uint8_t *month,
+                     uint8_t *day);
+
 /**
  * Get the length of the given year in days.
  *
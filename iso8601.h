@@ -23,8 +23,16 @@
 #include <stdlib.h>
 #include <time.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define ISO8601_FLAG_NONE  (0 << 0)
 #define ISO8601_FLAG_BASIC (1 << 0)
+#define ISO8601_FLAG_MILLI (1 << 1) /* Write exactly 3 decimal digits. */
+#define ISO8601_FLAG_MICRO (1 << 2) /* Write exactly 6 decimal digits. */
+#define ISO8601_FLAG_NANO  (1 << 3) /* Write exactly 9 decimal digits. */
+#define ISO8601_FLAG_TRUSTED (1 << 4) /* See iso8601_formatter_init(). */
 
 typedef struct {
     int32_t year;
@@ -36,8 +44,60 @@ typedef struct {
     uint32_t usecond;
     bool localtime;
     int16_t tzminutes;
+    uint16_t nsecond; /* Nanoseconds in addition to usecond (0-999). */
 } iso8601_time;
 
+/*
+ * A duration, such as P1Y2M3DT4H5M6.5S. Fractions of weeks, days, hours,
+ * minutes and seconds are carried exactly into the smaller fields.
+ */
+typedef struct {
+    uint32_t years;
+    uint32_t months;
+    uint32_t weeks;
+    uint32_t days;
+    uint32_t hours;
+    uint32_t minutes;
+    uint32_t seconds;
+    uint32_t useconds; /* 0-999999 */
+    uint16_t nseconds; /* Nanoseconds in addition to useconds (0-999). */
+    bool negative;     /* The duration runs backwards in time (-P...). */
+} iso8601_duration;
+
+/* A time interval, as parsed by iso8601_parse_interval(). */
+typedef struct {
+    iso8601_time start;
+    iso8601_time end;
+    int64_t start_us; /* The start in microseconds since the epoch. */
+    int64_t span_us;  /* The length of the interval in microseconds. */
+} iso8601_interval;
+
+/*
+ * A recurring time interval, as parsed by iso8601_parse_recurrence(). The
+ * occurrence with index i is start plus i times the period.
+ */
+typedef struct {
+    iso8601_time start;      /* The first occurrence. */
+    iso8601_duration period; /* The time between occurrences. */
+    int64_t count;           /* The number of occurrences; -1 if unbounded. */
+    int64_t next;            /* The index of the next occurrence. */
+    int16_t tzminutes;       /* The offset of the occurrences in minutes. */
+} iso8601_recurrence;
+
+/* Columnar (struct of arrays) form of iso8601_time. NULL columns are skipped. */
+typedef struct {
+    int32_t *year;
+    uint8_t *month;
+    uint8_t *day;
+    uint8_t *hour;
+    uint8_t *minute;
+    uint8_t *second;
+    uint32_t *usecond;
+    bool *localtime;
+    int16_t *tzminutes;
+    uint16_t *nsecond;
+} iso8601_columns;
+
 typedef enum {
     ISO8601_FORMAT_NORMAL = 0,
     ISO8601_FORMAT_WEEKDATE,
@@ -58,6 +118,111 @@ typedef enum {
     ISO8601_TRUNCATE_ORDINAL = ISO8601_TRUNCATE_MONTH
 } iso8601_truncate;
 
+typedef enum {
+    ISO8601_ZONE_LOCAL = 0, /* No zone designator. */
+    ISO8601_ZONE_UTC,       /* Z */
+    ISO8601_ZONE_OFFSET,    /* +hh, +hh:mm or +hhmm */
+    ISO8601_ZONE_ANY        /* Any of the above. */
+} iso8601_zone;
+
+/* The unit of a time since the Unix epoch. */
+typedef enum {
+    ISO8601_UNIT_SECOND = 0,
+    ISO8601_UNIT_MILLI,
+    ISO8601_UNIT_MICRO,
+    ISO8601_UNIT_NANO
+} iso8601_unit;
+
+/* A fixed string layout, using the same terms as iso8601_unparse(). */
+typedef struct {
+    iso8601_format format;
+    iso8601_truncate truncate;
+    uint32_t flags;
+    uint8_t decimals; /* Exact number of decimal digits; 0 for none. */
+    iso8601_zone zone;
+} iso8601_layout;
+
+/*
+ * A parser which adapts to its input. Zero-initialize it before first use.
+ * The counters may be read at any time.
+ */
+typedef struct {
+    iso8601_layout layout; /* Layout of the last timestamp parsed. */
+    bool learned;          /* Whether layout is valid. */
+    uint64_t hits;         /* Parses which matched the layout. */
+    uint64_t misses;       /* Parses which needed layout detection. */
+} iso8601_parser;
+
+/*
+ * A parser for timestamps which arrive in pieces, as from a socket. Zero-
+ * initialize it before first use. The start of a timestamp which crosses a
+ * chunk boundary is kept here, so nothing is allocated.
+ */
+typedef struct {
+    char buf[64];  /* Bytes of the timestamp from previous chunks. */
+    uint8_t len;   /* Number of bytes in buf. */
+    bool overflow; /* The timestamp didn't fit in buf. */
+    bool cr;       /* The last delimiter was a carriage return. */
+} iso8601_push_parser;
+
+/*
+ * A formatter with fixed settings, built by iso8601_formatter_init(). The
+ * output up to the timezone always has the same layout: pattern holds its
+ * fixed characters and each offset is where a field is written, or -1 if the
+ * field isn't written.
+ */
+typedef struct {
+    char pattern[40];          /* The output before the timezone. */
+    uint8_t len;               /* The length of the pattern. */
+    uint8_t ydigits;
+    uint8_t precision;         /* The number of decimal digits. */
+    uint32_t flags;
+    iso8601_format format;
+    iso8601_truncate truncate;
+    int8_t month;
+    int8_t day;
+    int8_t week;
+    int8_t wday;
+    int8_t ordinal;
+    int8_t hour;
+    int8_t minute;
+    int8_t second;
+    int8_t fraction;
+} iso8601_formatter;
+
+/* The most bytes a formatter writes for one time, not counting the NUL. */
+#define ISO8601_FORMATTER_MAX 46
+
+/*
+ * A formatter which remembers the last time it wrote in full, for times
+ * which mostly share their date, hour and minute with the one before. Set
+ * up formatter with iso8601_formatter_init() and zero-initialize the rest
+ * before first use, and again whenever formatter is changed.
+ */
+typedef struct {
+    iso8601_formatter formatter;
+    iso8601_time last;                   /* The time last written in full. */
+    char buf[ISO8601_FORMATTER_MAX + 1]; /* Its output. */
+    uint8_t len;                         /* The length of its output. */
+    bool cached;                         /* Whether buf may be reused. */
+} iso8601_incremental;
+
+/*
+ * Runs work on the caller's threads, for the parallel batch functions. It
+ * must call task(arg, worker) once for each worker from 0 to workers - 1,
+ * concurrently if it can, and return once all of the calls have returned.
+ */
+typedef void (*iso8601_executor)(void *ctx, size_t workers,
+                                 void (*task)(void *arg, size_t worker),
+                                 void *arg);
+
+/* A timestamp found by iso8601_scan(). */
+typedef struct {
+    size_t offset; /* Offset of the first byte of the timestamp. */
+    size_t length; /* Number of bytes in the timestamp. */
+    iso8601_time time;
+} iso8601_match;
+
 /**
  * Parse an ISO 8601 string into a time structure.
  *
@@ -66,12 +231,276 @@ typedef enum {
  */
 int iso8601_parse(const char *in, iso8601_time *out);
 
+/**
+ * Parse an ISO 8601 string of at most len bytes into a time structure.
+ *
+ * The input does not need to be NUL-terminated. The longest timestamp at the
+ * start of the input is parsed and, if end is not NULL, end is set to the
+ * first byte after it. If end is NULL, the entire input must be consumed.
+ *
+ * @return 0: success
+ * @return EINVAL: input is invalid
+ */
+int iso8601_parse_n(const char *in, size_t len, const char **end,
+                    iso8601_time *out);
+
+/**
+ * Parse an ISO 8601 string of at most len bytes into a normalized time.
+ *
+ * This behaves like iso8601_parse_n(), but hour 24 is folded into the next
+ * day and a time with a timezone is converted to UTC, so that tzminutes is
+ * 0. Local times keep their fields, and leap seconds are not folded.
+ * iso8601_compare() compares normalized times without normalizing them
+ * again, so this is cheaper for times which are compared repeatedly.
+ *
+ * @return 0: success
+ * @return EINVAL: input is invalid
+ */
+int iso8601_parse_normalized(const char *in, size_t len, const char **end,
+                             iso8601_time *out);
+
+/**
+ * Check that an ISO 8601 string of at most len bytes is valid.
+ *
+ * The same input is accepted as by iso8601_parse_n() with a NULL end, but no
+ * time structure is produced, so weekdates and ordinals are range checked
+ * without being converted into calendar dates. A length of SIZE_MAX denotes
+ * NUL-terminated input.
+ *
+ * @return 0: success
+ * @return EINVAL: input is invalid
+ */
+int iso8601_validate(const char *in, size_t len);
+
+/**
+ * Parse an ISO 8601 string of at most len bytes with a known layout.
+ *
+ * Instead of detecting the layout of the input, the input must match the
+ * given layout exactly. Otherwise this behaves like iso8601_parse_n().
+ *
+ * @return 0: success
+ * @return EINVAL: input is invalid or doesn't match the layout
+ */
+int iso8601_parse_layout(const iso8601_layout *layout, const char *in,
+                         size_t len, const char **end, iso8601_time *out);
+
+/**
+ * Parse an ISO 8601 string of at most len bytes into a time since the epoch.
+ *
+ * The result is the signed number of units since 1970-01-01T00:00:00Z,
+ * rounded towards negative infinity. It is computed arithmetically, without
+ * the C library. Input without a timezone is taken to be at the offset in
+ * minutes pointed to by localzone. Otherwise this behaves like
+ * iso8601_parse_n().
+ *
+ * @return 0: success
+ * @return EINVAL: input is invalid
+ * @return EDOM: input has no timezone and localzone is NULL
+ * @return ERANGE: the result doesn't fit in 64 bits
+ */
+int iso8601_parse_epoch(const char *in, size_t len, const char **end,
+                        iso8601_unit unit, const int16_t *localzone,
+                        int64_t *out);
+
+/**
+ * Parse an ISO 8601 duration of at most len bytes.
+ *
+ * Both the designator format (PnYnMnDTnHnMnS, PnW) and the alternative
+ * format (PYYYY-MM-DDThh:mm:ss, PYYYYMMDDThhmmss) are accepted, optionally
+ * preceded by a minus sign. Only the last component may have a decimal, and
+ * years and months may not have one. A designator component has at most ten
+ * digits and must fit in its field. The length and end work as in
+ * iso8601_parse_n().
+ *
+ * @return 0: success
+ * @return EINVAL: input is invalid
+ */
+int iso8601_parse_duration(const char *in, size_t len, const char **end,
+                           iso8601_duration *out);
+
+/**
+ * Parse an ISO 8601 time interval of at most len bytes.
+ *
+ * The interval may be given as start/end, start/duration or duration/end.
+ * The end may omit leading components, which are then taken from the start
+ * (2007-12-14T13:30/15:30). Such an end must be laid out like the start,
+ * down to the same last component, with each of its fields in full; without
+ * a timezone, it takes that of the start. Endpoints without a timezone are
+ * otherwise taken to be at the offset in minutes pointed to by localzone.
+ * The length and end work as in iso8601_parse_n().
+ *
+ * @return 0: success
+ * @return EINVAL: input is invalid or the interval ends before it starts
+ * @return EDOM: an endpoint has no timezone and localzone is NULL
+ * @return ERANGE: an endpoint doesn't fit in 64-bit microseconds
+ */
+int iso8601_parse_interval(const char *in, size_t len, const char **end,
+                           const int16_t *localzone, iso8601_interval *out);
+
+/**
+ * Parse an ISO 8601 recurring time interval of at most len bytes.
+ *
+ * The recurrence is written as Rn/interval, where the number of occurrences
+ * n may be omitted for an unbounded recurrence. The interval is given as in
+ * iso8601_parse_interval(). For start/end, the period is the exact time
+ * between the two; for duration/end, n is required and the last occurrence
+ * ends at the end. The period must be positive. If the start has no
+ * timezone, it is taken to be at the offset in minutes pointed to by
+ * localzone. The length and end work as in iso8601_parse_n().
+ *
+ * Nothing is expanded: use iso8601_recurrence_next() to step through the
+ * occurrences and iso8601_recurrence_seek() to jump to a point in time.
+ *
+ * @return 0: success
+ * @return EINVAL: input is invalid
+ * @return EDOM: the start has no timezone and localzone is NULL
+ * @return ERANGE: the start or the period doesn't fit
+ */
+int iso8601_parse_recurrence(const char *in, size_t len, const char **end,
+                             const int16_t *localzone,
+                             iso8601_recurrence *out);
+
+/**
+ * Parse an ISO 8601 string of at most len bytes, learning its layout.
+ *
+ * The input is first parsed with the layout of the last timestamp the parser
+ * accepted, as with iso8601_parse_layout(). If that fails, the layout is
+ * detected as with iso8601_parse_n() and remembered for the next call. The
+ * result is always the same as that of iso8601_parse_n().
+ *
+ * @return 0: success
+ * @return EINVAL: input is invalid
+ */
+int iso8601_parser_parse(iso8601_parser *parser, const char *in, size_t len,
+                         const char **end, iso8601_time *out);
+
+/**
+ * Find the next ISO 8601 timestamp in a text of len bytes.
+ *
+ * The search begins at *pos. A timestamp must stand on its own as a word and
+ * must have either an extended date (YYYY-...) or a basic date followed by
+ * a time (YYYYMMDDT...). On success, match receives the timestamp and *pos
+ * is advanced past it, so calling this in a loop finds every timestamp in a
+ * single pass over the text. A length of SIZE_MAX denotes NUL-terminated
+ * input, which is read no further than its NUL.
+ *
+ * @return 0: success
+ * @return ENOENT: there are no more timestamps
+ * @return EINVAL: input is invalid
+ */
+int iso8601_scan(const char *in, size_t len, size_t *pos,
+                 iso8601_match *match);
+
+/**
+ * Push the next chunk of len bytes of a stream into the parser.
+ *
+ * A timestamp ends at the first byte which can't be part of one, such as a
+ * space, a comma or a newline, and must span everything before that byte.
+ * That byte is consumed along with the timestamp, so *consumed counts the
+ * bytes of the chunk up to and including it, and the rest of the chunk can
+ * be pushed as it is:
+ *
+ *     while (len > 0) {
+ *         err = iso8601_push_parse(&parser, in, len, &consumed, &time);
+ *         in += consumed;
+ *         len -= consumed;
+ *         ...
+ *     }
+ *
+ * Two delimiters in a row enclose an empty, and so invalid, timestamp, but
+ * a CRLF line ending counts as one delimiter even if it is split across
+ * chunks. If the chunk ends first, the whole chunk is consumed and kept for
+ * the next call. A timestamp which ends within the chunk it starts in is
+ * parsed in place, without any copy.
+ *
+ * @return 0: success
+ * @return EAGAIN: the timestamp continues in the next chunk
+ * @return EINVAL: input is invalid; *consumed bytes were skipped
+ */
+int iso8601_push_parse(iso8601_push_parser *parser, const char *in, size_t len,
+                       size_t *consumed, iso8601_time *out);
+
+/**
+ * End the stream, parsing the timestamp which the parser holds.
+ *
+ * @return 0: success
+ * @return ENOENT: the parser holds no timestamp
+ * @return EINVAL: input is invalid
+ */
+int iso8601_push_finish(iso8601_push_parser *parser, iso8601_time *out);
+
+/**
+ * Parse an array of n ISO 8601 strings into an array of time structures.
+ *
+ * If lens is NULL, the strings are NUL-terminated. Otherwise, lens[i] is the
+ * length of in[i] and each string must be consumed entirely, as with
+ * iso8601_parse_n(). If status is not NULL, status[i] receives the result of
+ * parsing in[i]. Invalid elements leave out[i] untouched.
+ *
+ * @return 0: all elements were parsed successfully
+ * @return EINVAL: at least one element is invalid
+ */
+int iso8601_parse_batch(const char *const *in, const size_t *lens, size_t n,
+                        iso8601_time *out, int *status);
+
+/**
+ * Parse a column of n ISO 8601 strings into separate field columns.
+ *
+ * The input uses the Apache Arrow string layout: string i is stored in
+ * data[offsets[i]] up to (but excluding) data[offsets[i + 1]], so offsets
+ * has n + 1 entries. Each string must be consumed entirely. Field i of each
+ * non-NULL column in out receives the parsed value of string i. If status is
+ * not NULL, status[i] receives the result of parsing string i. Invalid
+ * elements leave their rows untouched.
+ *
+ * @return 0: all elements were parsed successfully
+ * @return EINVAL: at least one element is invalid
+ */
+int iso8601_parse_column32(const char *data, const int32_t *offsets,
+                           size_t n, const iso8601_columns *out, int *status);
+
+/**
+ * Parse a column of n ISO 8601 strings with 64-bit offsets.
+ *
+ * See iso8601_parse_column32().
+ */
+int iso8601_parse_column64(const char *data, const int64_t *offsets,
+                           size_t n, const iso8601_columns *out, int *status);
+
+/**
+ * Parse an array of n ISO 8601 strings on several threads.
+ *
+ * The arguments and the result are as for iso8601_parse_batch(). The input
+ * is split into cache-sized chunks which are shared out among the workers;
+ * a worker which runs out of chunks steals from the others. If executor is
+ * NULL, threads workers run on a pool of threads owned by the library, or
+ * one per online CPU if threads is 0; the caller runs one of them. The pool
+ * starts threads as calls first need them, at a cost of some tens of
+ * microseconds each, and keeps them for the life of the process, so later
+ * calls only wake them, which takes a few microseconds. One call uses the
+ * pool at a time; a call made meanwhile runs on the caller's thread alone.
+ * Otherwise, the executor runs threads workers, which must be at least one.
+ *
+ * @return 0: all elements were parsed successfully
+ * @return EINVAL: at least one element is invalid
+ * @return ENOMEM: out of memory
+ */
+int iso8601_parse_batch_parallel(const char *const *in, const size_t *lens,
+                                 size_t n, iso8601_time *out, int *status,
+                                 size_t threads, iso8601_executor executor,
+                                 void *ctx);
+
 /**
  * Unparse a time structure into an ISO 8601 string.
  *
  * The year can be represented in ydigits number of digits, between 2 and 9.
  * However, any number besides 4 internally disables ISO8601_FLAG_BASIC.
  *
+ * Without truncation, the decimal is written with 6 digits if usecond is
+ * non-zero, or 9 if nsecond is non-zero. At most one of ISO8601_FLAG_MILLI,
+ * ISO8601_FLAG_MICRO and ISO8601_FLAG_NANO may be given to always write that
+ * many digits instead; the fraction is truncated, never rounded.
+ *
  * @return 0: success
  * @return EINVAL: input is invalid
  * @return E2BIG: the output buffer is too small to handle the output
@@ -80,6 +509,155 @@ int iso8601_unparse(const iso8601_time *in, uint32_t flags, uint8_t ydigits,
                     iso8601_format format, iso8601_truncate truncate,
                     size_t len, char *out);
 
+/**
+ * Build a formatter which unparses times with fixed settings.
+ *
+ * The flags, ydigits, format and truncate are as for iso8601_unparse(),
+ * except that the decimal is always written with precision digits (0-9), so
+ * ISO8601_FLAG_MILLI, ISO8601_FLAG_MICRO and ISO8601_FLAG_NANO may not be
+ * given. With ISO8601_FLAG_TRUSTED, iso8601_formatter_write() doesn't
+ * validate its input. Only use it for times the library produced, such as
+ * by parsing: the result of writing an invalid time is undefined.
+ *
+ * @return 0: success
+ * @return EINVAL: input is invalid
+ */
+int iso8601_formatter_init(uint32_t flags, uint8_t ydigits,
+                           iso8601_format format, iso8601_truncate truncate,
+                           uint8_t precision, iso8601_formatter *out);
+
+/**
+ * Unparse a time structure with a formatter.
+ *
+ * Only the fields of the time are written into a copy of the formatter's
+ * pattern, followed by the timezone. The output is the same as that of
+ * iso8601_unparse() with the same settings and the same number of decimal
+ * digits. A year which doesn't fit the pattern, such as one which needs a
+ * sign, is written as by iso8601_unparse(). If written is not NULL, it
+ * receives the length of the output, without its NUL.
+ *
+ * @return 0: success
+ * @return EINVAL: input is invalid
+ * @return E2BIG: the output buffer is too small to handle the output
+ */
+int iso8601_formatter_write(const iso8601_formatter *formatter,
+                            const iso8601_time *in, size_t len, char *out,
+                            size_t *written);
+
+/**
+ * Unparse a time structure with an incremental formatter.
+ *
+ * The output is the same as that of iso8601_formatter_write(). When the time
+ * is in the same minute and timezone as the last one written in full, the
+ * remembered output is copied and only the seconds and the fraction are
+ * written into it; only they are validated. Otherwise, the time is written
+ * in full and remembered. Bytes of out past the NUL may be overwritten.
+ *
+ * @return 0: success
+ * @return EINVAL: input is invalid
+ * @return E2BIG: the output buffer is too small to handle the output
+ */
+int iso8601_incremental_write(iso8601_incremental *incremental,
+                              const iso8601_time *in, size_t len, char *out,
+                              size_t *written);
+
+/**
+ * Unparse a time since the epoch with a formatter.
+ *
+ * The value is the signed number of units since 1970-01-01T00:00:00Z, as
+ * produced by iso8601_parse_epoch(). It is written as the wall clock time at
+ * the offset of tzminutes from UTC, converted arithmetically without the C
+ * library or a time structure. The output is otherwise the same as that of
+ * iso8601_formatter_write().
+ *
+ * @return 0: success
+ * @return EINVAL: unit, tzminutes or an argument is invalid
+ * @return ERANGE: the year is outside -99999 to 99999
+ * @return E2BIG: the output buffer is too small to handle the output
+ */
+int iso8601_unparse_epoch(int64_t value, iso8601_unit unit,
+                          int16_t tzminutes,
+                          const iso8601_formatter *formatter, size_t len,
+                          char *out, size_t *written);
+
+/**
+ * Unparse n time structures with a formatter into a column of strings.
+ *
+ * The output uses the Apache Arrow string layout, as read by
+ * iso8601_parse_column32(): the strings are written back to back into the
+ * len bytes at data, without NULs, and string i runs from data[offsets[i]]
+ * up to data[offsets[i + 1]], so offsets receives n + 1 entries. An element
+ * which fails is written as an empty string. If status is not NULL,
+ * status[i] receives the result for in[i]. No element takes more than
+ * ISO8601_FORMATTER_MAX bytes.
+ *
+ * @return 0: all elements were unparsed successfully
+ * @return EINVAL: at least one element is invalid
+ * @return E2BIG: data is too small; only the elements before the one which
+ *                didn't fit are written
+ */
+int iso8601_unparse_column32(const iso8601_formatter *formatter,
+                             const iso8601_time *in, size_t n, char *data,
+                             size_t len, int32_t *offsets, int *status);
+
+/**
+ * Unparse n time structures into a column of strings with 64-bit offsets.
+ *
+ * See iso8601_unparse_column32().
+ */
+int iso8601_unparse_column64(const iso8601_formatter *formatter,
+                             const iso8601_time *in, size_t n, char *data,
+                             size_t len, int64_t *offsets, int *status);
+
+/**
+ * Unparse n time structures with a formatter into fixed-width slots.
+ *
+ * Element i is written to the width bytes at data + i * width, without a
+ * NUL, as in an Apache Arrow fixed-size binary column. Each output must be
+ * exactly width bytes long: for example, UTC times take the length of the
+ * formatter's pattern plus one for the Z. A slot whose element fails is
+ * filled with zeros. If status is not NULL, status[i] receives the result
+ * for in[i]: E2BIG if the output is longer than width, or EINVAL if it is
+ * shorter or the element is invalid.
+ *
+ * @return 0: all elements were unparsed successfully
+ * @return EINVAL: at least one element failed
+ */
+int iso8601_unparse_fixed(const iso8601_formatter *formatter,
+                          const iso8601_time *in, size_t n, size_t width,
+                          char *data, int *status);
+
+/**
+ * Unparse a duration into an ISO 8601 string in the designator format.
+ *
+ * Zero components are omitted; a zero duration is written as PT0S.
+ *
+ * @return 0: success
+ * @return EINVAL: input is invalid
+ * @return E2BIG: the output buffer is too small to handle the output
+ */
+int iso8601_unparse_duration(const iso8601_duration *in, size_t len,
+                             char *out);
+
+/**
+ * Unparse an array of n time structures on several threads.
+ *
+ * Element i is written as with iso8601_unparse() into the len bytes at
+ * out + i * len. If status is not NULL, status[i] receives the result of
+ * unparsing in[i]. The work is shared out as in
+ * iso8601_parse_batch_parallel().
+ *
+ * @return 0: all elements were unparsed successfully
+ * @return EINVAL: at least one element failed
+ * @return ENOMEM: out of memory
+ */
+int iso8601_unparse_batch_parallel(const iso8601_time *in, size_t n,
+                                   uint32_t flags, uint8_t ydigits,
+                                   iso8601_format format,
+                                   iso8601_truncate truncate, size_t len,
+                                   char *out, int *status, size_t threads,
+                                   iso8601_executor executor, void *ctx);
+
 /**
  * Returns the current time as a time structure.
  *
@@ -97,6 +675,12 @@ int iso8601_current(bool localtime, int16_t tzminutes, iso8601_time *out);
  */
 int iso8601_compare(const iso8601_time *a, const iso8601_time *b);
 
+/**
+ * Check whether an instant, in microseconds since the epoch, lies within the
+ * interval. The start is included and the end is not.
+ */
+bool iso8601_interval_contains(const iso8601_interval *interval, int64_t us);
+
 /**
  * Convert a time structure to a tm structure.
  */
@@ -164,3 +748,44 @@ void iso8601_add_seconds(iso8601_time *time, int seconds);
  * Add the specified number of useconds to the time.
  */
 void iso8601_add_useconds(iso8601_time *time, int useconds);
+
+/**
+ * Add (or, if negative, subtract) a duration to the time.
+ *
+ * The result is the same as adding the years, months, days (including
+ * weeks), hours, minutes, seconds and useconds one after another, but the
+ * time is normalized only once.
+ *
+ * @return 0: success
+ * @return EINVAL: input is invalid
+ * @return ERANGE: the resulting year doesn't fit in the time structure
+ */
+int iso8601_add_duration(iso8601_time *time, const iso8601_duration *duration);
+
+/**
+ * Get the next occurrence of a recurrence and advance past it.
+ *
+ * Each occurrence is computed directly from the start, in constant time.
+ *
+ * @return 0: success
+ * @return EINVAL: input is invalid
+ * @return ENOENT: there are no more occurrences
+ */
+int iso8601_recurrence_next(iso8601_recurrence *recurrence, iso8601_time *out);
+
+/**
+ * Position a recurrence at its first occurrence at or after an instant, in
+ * microseconds since the epoch, so that it is the next to be returned.
+ *
+ * The position is computed from the period rather than by stepping through
+ * the occurrences.
+ *
+ * @return 0: success
+ * @return EINVAL: input is invalid
+ * @return ENOENT: there is no such occurrence
+ */
+int iso8601_recurrence_seek(iso8601_recurrence *recurrence, int64_t us);
+
+#ifdef __cplusplus
+}
+#endif
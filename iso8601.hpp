@@ -0,0 +1,482 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/**
+ * Copyright: 2013 Red Hat, Inc.
+ * Author: Nathaniel McCallum <npmccallum@redhat.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "iso8601.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+/*
+ * Compile-time ISO 8601 for C++14 and later.
+ *
+ * The functions here are constexpr versions of iso8601_parse(), the
+ * comparison of iso8601_compare() and the epoch conversion of
+ * iso8601_parse_epoch(). They work on the plain iso8601_time structure.
+ * When the result initializes a constexpr variable, the work is done by the
+ * compiler and an invalid literal is a compile error:
+ *
+ *     using namespace iso8601::literals;
+ *
+ *     constexpr iso8601_time cutover = "2024-07-01T00:00Z"_iso8601;
+ *     static_assert(iso8601::epoch(cutover) == 1719792000, "");
+ *
+ * Evaluated at run time, the same functions throw std::invalid_argument or
+ * std::range_error instead of returning EINVAL or ERANGE.
+ */
+
+namespace iso8601 {
+namespace detail {
+
+/* Fail unless ok. In a constant expression, failing is a compile error. */
+constexpr bool check(bool ok, const char *what)
+{
+    return ok ? true : throw std::invalid_argument(what);
+}
+
+constexpr bool check_range(bool ok, const char *what)
+{
+    return ok ? true : throw std::range_error(what);
+}
+
+/* The calendar math of internal.c. */
+
+constexpr bool is_leapyear(int32_t year)
+{
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+constexpr int64_t days_from_civil(int32_t year, uint8_t month, uint8_t day)
+{
+    const int64_t y = (int64_t) year - (month <= 2);
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int64_t yoe = y - era * 400;
+    const int64_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5
+                        + day - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * 146097 + doe - 719468;
+}
+
+constexpr int weekdate_offset(int32_t year)
+{
+    const int wday = ((days_from_civil(year, 1, 1) + 4) % 7 + 7) % 7;
+
+    return wday == 5 || wday == 6 ? 8 - wday : 1 - wday;
+}
+
+constexpr uint16_t length_year_days(int32_t year)
+{
+    return is_leapyear(year) ? 366 : 365;
+}
+
+constexpr uint8_t length_year_weeks(int32_t year)
+{
+    return (length_year_days(year) - weekdate_offset(year) + 3) / 7;
+}
+
+constexpr uint8_t length_month_days(int32_t year, uint8_t month)
+{
+    switch (month) {
+    case 2:
+        return is_leapyear(year) ? 29 : 28;
+    case 4: case 6: case 9: case 11:
+        return 30;
+    default:
+        return 31;
+    }
+}
+
+constexpr void ordinal_to_date(int32_t year, int32_t ordinal,
+                               uint8_t &month, uint8_t &day)
+{
+    for (month = 1; ordinal > length_month_days(year, month); month++)
+        ordinal -= length_month_days(year, month);
+
+    day = ordinal;
+}
+
+constexpr void weekdate_to_date(iso8601_time &time, int32_t week,
+                                int32_t wday)
+{
+    int32_t ordinal = (week - 1) * 7 + wday + weekdate_offset(time.year);
+
+    if (ordinal > length_year_days(time.year))
+        ordinal -= length_year_days(time.year++);
+    else if (ordinal < 1)
+        ordinal += length_year_days(--time.year);
+
+    ordinal_to_date(time.year, ordinal, time.month, time.day);
+}
+
+/* The grammar of parse.c, without the fast path. */
+
+constexpr bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+class cursor {
+public:
+    constexpr cursor(const char *str, std::size_t len) : str_(str), len_(len)
+    {
+    }
+
+    constexpr char peek(std::size_t offset) const
+    {
+        return offset < len_ ? str_[offset] : '\0';
+    }
+
+    constexpr void skip(std::size_t count)
+    {
+        str_ += count;
+        len_ -= count;
+    }
+
+    constexpr bool empty() const
+    {
+        return len_ == 0;
+    }
+
+    constexpr std::size_t count_digits(std::size_t offset) const
+    {
+        std::size_t i = offset;
+
+        while (is_digit(peek(i)))
+            i++;
+
+        return i - offset;
+    }
+
+    constexpr bool expect(char chr)
+    {
+        if (peek(0) != chr)
+            return false;
+
+        skip(1);
+        return true;
+    }
+
+    constexpr bool accept_field(char sep)
+    {
+        const std::size_t offset = peek(0) == sep ? 1 : 0;
+
+        if (count_digits(offset) < 2)
+            return false;
+
+        skip(offset);
+        return true;
+    }
+
+    constexpr int32_t convert(std::size_t digits, int32_t min, int32_t max)
+    {
+        int32_t value = 0;
+
+        for (std::size_t i = 0; i < digits; i++) {
+            check(is_digit(peek(i)), "ISO 8601: expected a digit");
+            value = value * 10 + peek(i) - '0';
+        }
+
+        check(value >= min && (max < 0 || value <= max),
+              "ISO 8601: field out of range");
+        skip(digits);
+        return value;
+    }
+
+private:
+    const char *str_;
+    std::size_t len_;
+};
+
+constexpr std::size_t expanded_year_digits(const cursor &c)
+{
+    const std::size_t digits = c.count_digits(0);
+
+    switch (c.peek(digits)) {
+    case 'W':
+        return digits;
+
+    case '-':
+        if (c.peek(digits + 1) == 'W')
+            return digits;
+
+        if (c.count_digits(digits + 1) == 2 && c.peek(digits + 3) == '-' &&
+            c.count_digits(digits + 4) == 2 && c.peek(digits + 6) == 'T')
+            return digits;
+        break;
+    }
+
+    return 4;
+}
+
+constexpr void parse_year(cursor &c, iso8601_time &time)
+{
+    std::size_t digits = 4;
+    int multiplier = 1;
+
+    if (c.peek(0) == '-' || c.peek(0) == '+') {
+        multiplier = c.peek(0) == '-' ? -1 : 1;
+        c.skip(1);
+        digits = expanded_year_digits(c);
+    }
+
+    check(digits >= 4 && digits <= 9, "ISO 8601: invalid year");
+    time.year = c.convert(digits, 0, -1) * multiplier;
+    time.month = 1;
+    time.day = 1;
+}
+
+constexpr void parse_weekdate(cursor &c, iso8601_time &time)
+{
+    int32_t wday = 1;
+    int32_t week = 0;
+
+    c.skip(1); /* Consume the W. */
+    week = c.convert(2, 1, length_year_weeks(time.year));
+
+    if (c.peek(0) == '-') {
+        if (c.count_digits(1) % 2 == 1) {
+            c.skip(1);
+            wday = c.convert(1, 1, 7);
+        }
+    } else if (c.count_digits(0) % 2 == 1) {
+        wday = c.convert(1, 1, 7);
+    }
+
+    weekdate_to_date(time, week, wday);
+}
+
+constexpr void parse_date(cursor &c, iso8601_time &time)
+{
+    if (c.peek(0) == 'W' && c.count_digits(1) >= 2)
+        return parse_weekdate(c, time);
+    if (c.peek(0) == '-' && c.peek(1) == 'W' && c.count_digits(2) >= 2) {
+        c.skip(1);
+        return parse_weekdate(c, time);
+    }
+
+    if (!c.accept_field('-'))
+        return;
+
+    if (c.count_digits(0) % 2 == 1) {
+        ordinal_to_date(time.year,
+                        c.convert(3, 1, length_year_days(time.year)),
+                        time.month, time.day);
+        return;
+    }
+
+    time.month = c.convert(2, 1, 12);
+    if (!c.accept_field('-'))
+        return;
+
+    time.day = c.convert(2, 1, length_month_days(time.year, time.month));
+}
+
+constexpr void parse_time(cursor &c, iso8601_time &time)
+{
+    uint64_t scale = 3600;
+    uint64_t nanos = 0;
+    uint32_t den = 1;
+
+    time.hour = c.convert(2, 0, 24);
+
+    if (c.accept_field(':')) {
+        time.minute = c.convert(2, 0, time.hour == 24 ? 0 : 59);
+        scale = 60;
+
+        if (c.accept_field(':')) {
+            time.second = c.convert(2, 0, time.hour == 24 ? 0 : 60);
+            scale = 1;
+        }
+    }
+
+    /* Only the first nine digits of the decimal count. */
+    if (c.peek(0) == '.' && is_digit(c.peek(1))) {
+        c.skip(1);
+        for (std::size_t i = 0; is_digit(c.peek(0)); i++) {
+            if (i < 9) {
+                nanos = nanos * 10 + c.peek(0) - '0';
+                den *= 10;
+            }
+            c.skip(1);
+        }
+    }
+
+    check(time.hour != 24 || nanos == 0, "ISO 8601: invalid decimal");
+    nanos = nanos * (1000000000 / den) * scale;
+
+    time.minute += nanos / 60000000000;
+    nanos %= 60000000000;
+    time.second += nanos / 1000000000;
+    nanos %= 1000000000;
+    time.usecond = nanos / 1000;
+    time.nsecond = nanos % 1000;
+}
+
+constexpr void parse_timezone(cursor &c, iso8601_time &time)
+{
+    const char sign = c.peek(0);
+    int32_t minutes = 0;
+    int32_t hours = 0;
+
+    if (c.expect('Z'))
+        return;
+
+    if ((sign != '+' && sign != '-') || c.count_digits(1) < 2) {
+        time.localtime = true;
+        return;
+    }
+
+    c.skip(1);
+    hours = c.convert(2, 0, 24);
+    if (c.accept_field(':'))
+        minutes = c.convert(2, 0, 59);
+
+    time.tzminutes = (hours * 60 + minutes) * (sign == '-' ? -1 : 1);
+}
+
+/* Get the minutes since the epoch in UTC, taking local times at zone. */
+constexpr int64_t epoch_minutes(const iso8601_time &time, int16_t zone)
+{
+    return (days_from_civil(time.year, time.month, time.day) * 24 +
+            time.hour) * 60 + time.minute -
+           (time.localtime ? zone : time.tzminutes);
+}
+
+} /* namespace detail */
+
+/**
+ * Parse an ISO 8601 string of len bytes, as with iso8601_parse_n().
+ *
+ * @throw std::invalid_argument: input is invalid
+ */
+constexpr iso8601_time parse(const char *str, std::size_t len)
+{
+    detail::cursor c(str, len);
+    iso8601_time time{};
+
+    detail::parse_year(c, time);
+    detail::parse_date(c, time);
+    if (c.accept_field('T'))
+        detail::parse_time(c, time);
+    detail::parse_timezone(c, time);
+
+    detail::check(c.empty(), "ISO 8601: trailing characters");
+    return time;
+}
+
+/**
+ * Parse an ISO 8601 string literal.
+ *
+ * @throw std::invalid_argument: input is invalid
+ */
+template <std::size_t N>
+constexpr iso8601_time parse(const char (&str)[N])
+{
+    return parse(str, N - 1);
+}
+
+/**
+ * Compare two time structures, as with iso8601_compare().
+ *
+ * A local time can only be compared with another local time at compile time.
+ * Otherwise, the comparison is left to the library at run time.
+ *
+ * @return 0: a == b
+ * @return <0: a < b
+ * @return >0: a > b
+ */
+constexpr int compare(const iso8601_time &a, const iso8601_time &b)
+{
+    if (a.localtime != b.localtime)
+        return iso8601_compare(&a, &b);
+
+    /* Hour 24 and the offsets fall out of the minutes. */
+    const int64_t ma = detail::epoch_minutes(a, 0);
+    const int64_t mb = detail::epoch_minutes(b, 0);
+
+    if (ma != mb)
+        return ma < mb ? -1 : 1;
+    if (a.second != b.second)
+        return a.second < b.second ? -1 : 1;
+    if (a.usecond != b.usecond)
+        return a.usecond < b.usecond ? -1 : 1;
+    if (a.nsecond != b.nsecond)
+        return a.nsecond < b.nsecond ? -1 : 1;
+
+    return 0;
+}
+
+/**
+ * Convert a time structure into a number of units since the epoch, as with
+ * iso8601_parse_epoch(). Local times are taken to be at the offset in minutes
+ * given by localzone.
+ *
+ * @throw std::range_error: the result doesn't fit in 64 bits
+ */
+constexpr int64_t epoch(const iso8601_time &time, iso8601_unit unit,
+                        int16_t localzone)
+{
+    const int64_t scale = unit == ISO8601_UNIT_NANO ? 1000000000 :
+                          unit == ISO8601_UNIT_MICRO ? 1000000 :
+                          unit == ISO8601_UNIT_MILLI ? 1000 : 1;
+    int64_t seconds = detail::epoch_minutes(time, localzone) * 60 +
+                      time.second;
+    int64_t fraction = ((int64_t) time.usecond * 1000 + time.nsecond) /
+                       (1000000000 / scale);
+
+    /* Before the epoch, borrow the fraction so that INT64_MIN is reachable. */
+    if (seconds < 0 && fraction > 0) {
+        seconds++;
+        fraction -= scale;
+    }
+
+    /* The fraction has the sign of the seconds, so neither bound overflows. */
+    detail::check_range(seconds > 0 ?
+                        seconds <= (INT64_MAX - fraction) / scale :
+                        seconds >= (INT64_MIN - fraction) / scale,
+                        "ISO 8601: epoch out of range");
+    return seconds * scale + fraction;
+}
+
+/**
+ * Convert a time structure with a timezone into a number of units since the
+ * epoch.
+ *
+ * @throw std::invalid_argument: the time is local
+ * @throw std::range_error: the result doesn't fit in 64 bits
+ */
+constexpr int64_t epoch(const iso8601_time &time,
+                        iso8601_unit unit = ISO8601_UNIT_SECOND)
+{
+    detail::check(!time.localtime, "ISO 8601: local time has no epoch");
+    return epoch(time, unit, 0);
+}
+
+inline namespace literals {
+
+/* A compile-time timestamp: "2024-01-01T00:00Z"_iso8601. */
+constexpr iso8601_time operator""_iso8601(const char *str, std::size_t len)
+{
+    return parse(str, len);
+}
+
+} /* namespace literals */
+} /* namespace iso8601 */
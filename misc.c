@@ -35,54 +35,55 @@ int iso8601_current(bool localtime, int16_t tzminutes, iso8601_time *out)
     return 0;
 }
 
-static void normalize(iso8601_time *time)
+static int compare_fields(const iso8601_time *a, const iso8601_time *b)
 {
-    /* Normalize where hour == 24. */
-    iso8601_add_hours(time, 0);
-
-    /* Normalize timezones. */
-    if (!time->localtime) {
-        iso8601_add_minutes(time, time->tzminutes * -1);
-        time->tzminutes = 0;
-    }
-
-    /* Don't normalize leap seconds! */
-}
-
-static int compare(const iso8601_time *a, const iso8601_time *b)
-{
-    iso8601_time tmpa = *a;
-    iso8601_time tmpb = *b;
     int diff;
 
-    normalize(&tmpa);
-    normalize(&tmpb);
+    diff = a->year - b->year;
+    if (diff != 0)
+        return diff;
 
-    diff = tmpa.year - tmpb.year;
+    diff = a->month - b->month;
     if (diff != 0)
         return diff;
 
-    diff = tmpa.month - tmpb.month;
+    diff = a->day - b->day;
     if (diff != 0)
         return diff;
 
-    diff = tmpa.day - tmpb.day;
+    diff = a->hour - b->hour;
     if (diff != 0)
         return diff;
 
-    diff = tmpa.hour - tmpb.hour;
+    diff = a->minute - b->minute;
     if (diff != 0)
         return diff;
 
-    diff = tmpa.minute - tmpb.minute;
+    diff = a->second - b->second;
     if (diff != 0)
         return diff;
 
-    diff = tmpa.second - tmpb.second;
+    diff = a->usecond - b->usecond;
     if (diff != 0)
         return diff;
 
-    return tmpa.usecond - tmpb.usecond;
+    return a->nsecond - b->nsecond;
+}
+
+static int compare(const iso8601_time *a, const iso8601_time *b)
+{
+    iso8601_time tmpa;
+    iso8601_time tmpb;
+
+    /* Times from iso8601_parse_normalized() need no copies. */
+    if (is_normalized(a) && is_normalized(b))
+        return compare_fields(a, b);
+
+    tmpa = *a;
+    tmpb = *b;
+    normalize(&tmpa);
+    normalize(&tmpb);
+    return compare_fields(&tmpa, &tmpb);
 }
 
 static int compare_tz(const iso8601_time *a, const iso8601_time *b)
@@ -130,7 +131,7 @@ static int compare_tz(const iso8601_time *a, const iso8601_time *b)
     else if (tva.tv_usec > tvb.tv_usec)
         return 1;
 
-    return 0;
+    return a->nsecond - b->nsecond;
 }
 
 int iso8601_compare(const iso8601_time *a, const iso8601_time *b)
@@ -141,6 +142,15 @@ int iso8601_compare(const iso8601_time *a, const iso8601_time *b)
     return compare(a, b);
 }
 
+bool iso8601_interval_contains(const iso8601_interval *interval, int64_t us)
+{
+    if (us < interval->start_us)
+        return false;
+
+    return (uint64_t) us - (uint64_t) interval->start_us <
+           (uint64_t) interval->span_us;
+}
+
 void iso8601_to_tm(const iso8601_time *time, struct tm *tm)
 {
     tm->tm_year = time->year - 1900;
@@ -162,6 +172,7 @@ void iso8601_from_tm(const struct tm *tm, uint32_t usecond, bool localtime,
     time->minute = tm->tm_min;
     time->second = tm->tm_sec;
     time->usecond = usecond;
+    time->nsecond = 0;
     time->localtime = localtime;
     time->tzminutes = tzminutes;
 }
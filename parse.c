@@ -20,428 +20,1867 @@
 #include "internal.h"
 
 #include <errno.h>
-#include <ctype.h>
+#include <stdint.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /*
  * NOTE: According to ISO 8601:2004, decimal length is potentially unlimited.
- *       However, the assumed decimal max below exceeds IEEE 754 precision and
- *       should thus be acceptable for our uses.
+ *       We consume every digit of the decimal, but only the first
+ *       ISO8601_DEC digits contribute to the value.
+ */
+#define ISO8601_DEC 9
+
+/*
+ * The parser walks the input exactly once using a cursor. Reads past the end
+ * of the input return '\0', which is never part of the grammar. Since every
+ * lookahead stops at the first character which doesn't match, we never read
+ * past a terminating NUL.
+ */
+struct cursor {
+    const char *str;
+    size_t len;
+};
+
+static char peek(const struct cursor *c, size_t offset)
+{
+    return offset < c->len ? c->str[offset] : '\0';
+}
+
+static void skip(struct cursor *c, size_t count)
+{
+    c->str += count;
+    c->len -= count;
+}
+
+/*
+ * Character classes, so that classifying a byte is a single table lookup
+ * which doesn't depend on the locale.
+ */
+#define CLASS_DIGIT (1 << 0) /* 0-9 */
+#define CLASS_STAMP (1 << 1) /* May be part of a timestamp. */
+#define CLASS_WORD  (1 << 2) /* Letters and digits. */
+
+static const uint8_t CLASSES[256] = {
+    ['+'] = CLASS_STAMP,
+    ['-'] = CLASS_STAMP,
+    ['.'] = CLASS_STAMP,
+    [':'] = CLASS_STAMP,
+    ['0' ... '9'] = CLASS_DIGIT | CLASS_STAMP | CLASS_WORD,
+    ['A' ... 'S'] = CLASS_WORD,
+    ['T'] = CLASS_STAMP | CLASS_WORD,
+    ['U' ... 'V'] = CLASS_WORD,
+    ['W'] = CLASS_STAMP | CLASS_WORD,
+    ['X' ... 'Y'] = CLASS_WORD,
+    ['Z'] = CLASS_STAMP | CLASS_WORD,
+    ['a' ... 'z'] = CLASS_WORD,
+};
+
+static bool is_class(char c, uint8_t class)
+{
+    return CLASSES[(unsigned char) c] & class;
+}
+
+static bool is_digit(char c)
+{
+    return is_class(c, CLASS_DIGIT);
+}
+
+/* Whether a byte may be part of a timestamp. */
+static bool is_stamp(char c)
+{
+    return is_class(c, CLASS_STAMP);
+}
+
+/* Count the consecutive digits starting at offset. */
+static size_t count_digits(const struct cursor *c, size_t offset)
+{
+    size_t i;
+
+    for (i = offset; is_digit(peek(c, i)); i++)
+        continue;
+
+    return i - offset;
+}
+
+/* Accept exactly the given character. A NUL character always matches. */
+static bool expect(struct cursor *c, char chr)
+{
+    if (chr == '\0')
+        return true;
+
+    if (peek(c, 0) != chr)
+        return false;
+
+    skip(c, 1);
+    return true;
+}
+
+/*
+ * Detect a field of at least two digits, optionally preceded by a separator.
+ * If found, the separator is consumed. The digits are not.
  */
-#define ISO8601_DEC 35
-#define ISO8601_MAX (28 + ISO8601_DEC)
-#define ISO8601_MIN 4
+static bool accept_field(struct cursor *c, char sep)
+{
+    const size_t offset = peek(c, 0) == sep ? 1 : 0;
+
+    if (count_digits(c, offset) < 2)
+        return false;
+
+    skip(c, offset);
+    return true;
+}
 
-static bool convert(char *str, int offset, int digits,
-                    int min, int max, const char *end,
-                    int32_t *out)
+static bool convert(struct cursor *c, size_t digits,
+                    int32_t min, int32_t max, int32_t *out)
 {
     int32_t tmp = 0;
 
-    for (int i = 0; i < digits; i++) {
-        if (!isdigit(str[offset + i]))
+    for (size_t i = 0; i < digits; i++) {
+        const char chr = peek(c, i);
+        if (!is_digit(chr))
             return false;
         tmp *= 10;
-        tmp += str[offset + i] - '0';
+        tmp += chr - '0';
     }
 
     if (tmp < min || (max >= 0 && tmp > max))
         return false;
 
-    /* Consume the characters converted. */
-    if (end != NULL && strncmp(&str[offset + digits], end, strlen(end)) == 0)
-        offset += strlen(end);
-    memmove(str, &str[offset + digits], strlen(&str[offset + digits]) + 1);
+    skip(c, digits);
+    *out = tmp;
+    return true;
+}
+
+/* Convert a field of up to ten digits which must fit in a uint32_t. */
+static bool convert_uint32(struct cursor *c, size_t digits, uint32_t *out)
+{
+    int64_t tmp = 0;
+
+    if (digits > 10)
+        return false;
+
+    for (size_t i = 0; i < digits; i++) {
+        const char chr = peek(c, i);
+        if (!is_digit(chr))
+            return false;
+        tmp *= 10;
+        tmp += chr - '0';
+    }
+
+    if (tmp > UINT32_MAX)
+        return false;
+
+    skip(c, digits);
     *out = tmp;
     return true;
 }
 
-static bool convert_uint8(char *str, int offset, int digits,
-                          int min, int max, const char *end,
-                          uint8_t *out)
+static bool convert_uint8(struct cursor *c, size_t digits,
+                          int min, int max, uint8_t *out)
 {
     int32_t tmp;
-    bool retval;
 
-    retval = convert(str, offset, digits, min, max, end, &tmp);
+    if (!convert(c, digits, min, max, &tmp))
+        return false;
+
     *out = tmp;
-    return retval;
+    return true;
+}
+
+/*
+ * Determine the number of digits in an expanded (signed) year.
+ *
+ * Expanded years are only self-delimiting in a weekdate or in a full extended
+ * calendar date with a time (i.e. +YYYYYY-MM-DDT). In all other cases we
+ * assume four digits.
+ */
+static size_t expanded_year_digits(const struct cursor *c)
+{
+    const size_t digits = count_digits(c, 0);
+
+    switch (peek(c, digits)) {
+    case 'W':
+        return digits;
+
+    case '-':
+        if (peek(c, digits + 1) == 'W')
+            return digits;
+
+        if (count_digits(c, digits + 1) == 2 &&
+            peek(c, digits + 3) == '-' &&
+            count_digits(c, digits + 4) == 2 &&
+            peek(c, digits + 6) == 'T')
+            return digits;
+        break;
+    }
+
+    return 4;
+}
+
+static bool parse_year(struct cursor *c, iso8601_time *time)
+{
+    int multiplier = 1;
+    size_t digits = 4;
+
+    /* Parse year multiplier. */
+    switch (peek(c, 0)) {
+    case '-':
+        multiplier = -1;
+        /* fallthrough */
+    case '+':
+        skip(c, 1);
+        digits = expanded_year_digits(c);
+        break;
+    default:
+        break;
+    }
+
+    /* Nine digits is the most that fits in the year field. */
+    if (digits < 4 || digits > 9)
+        return false;
+
+    /* Convert the year. */
+    if (!convert(c, digits, 0, -1, &time->year))
+        return false;
+
+    time->year *= multiplier;
+    time->month = 1;
+    time->day = 1;
+    return true;
 }
 
-static bool parse_ordinal(char *buf, iso8601_time *time)
+/*
+ * When only checking, the ordinal and weekdate parsers check the ranges of
+ * their fields but don't convert them into a calendar date.
+ */
+static bool parse_ordinal(struct cursor *c, iso8601_time *time,
+                          bool check_only)
 {
     int32_t ordinal;
 
-    if (!convert(buf, 0, 3, 1, length_year_days(time->year), "T", &ordinal))
+    if (!convert(c, 3, 1, length_year_days(time->year), &ordinal))
         return false;
 
+    if (check_only)
+        return true;
+
     return ordinal_to_date(time->year, ordinal, &time->month, &time->day);
 }
 
-static bool parse_weekdate(char *buf, iso8601_time *time)
+static bool parse_weekdate(struct cursor *c, iso8601_time *time,
+                           iso8601_layout *layout, bool check_only)
 {
     int32_t wday = 1;
     int32_t week = 1;
 
+    layout->format = ISO8601_FORMAT_WEEKDATE;
+    layout->truncate = ISO8601_TRUNCATE_WEEK;
+
     /* Convert the week. */
-    if (!convert(buf, 1, 2, 1, length_year_weeks(time->year), "-", &week))
-        return EINVAL;
+    skip(c, 1); /* Consume the W. */
+    if (!convert(c, 2, 1, length_year_weeks(time->year), &week))
+        return false;
 
-    switch (buf[0]) {
-    case 'T':
-        memmove(&buf[0], &buf[1], strlen(&buf[1]) + 1); /* Consume the T. */
-        break;
-    case '\0':
-        break;
-    default:
-        /* Convert the week day, if specified. */
-        if ((strlen(buf) % 2 == 1) == (strchr(buf, 'T') == NULL)) {
-            if (!convert(buf, 0, 1, 1, 7, "T", &wday))
-                return EINVAL;
+    /*
+     * The week day is a single digit. When present, it is followed by an
+     * even number of time digits, so the number of digits remaining is
+     * odd. Otherwise, a dash introduces the timezone.
+     */
+    if (peek(c, 0) == '-') {
+        if (count_digits(c, 1) % 2 == 1) {
+            skip(c, 1);
+            if (!convert(c, 1, 1, 7, &wday))
+                return false;
+            layout->truncate = ISO8601_TRUNCATE_DAY;
         }
-        break;
+    } else if (count_digits(c, 0) % 2 == 1) {
+        if (!convert(c, 1, 1, 7, &wday))
+            return false;
+        layout->truncate = ISO8601_TRUNCATE_DAY;
     }
 
+    if (check_only)
+        return true;
+
     return weekdate_to_date(time->year, week, wday,
                             &time->year, &time->month, &time->day);
 }
 
-static bool parse_date(char *buf, iso8601_time *time)
+static bool parse_date(struct cursor *c, iso8601_time *time,
+                       iso8601_layout *layout, bool check_only)
 {
-    switch (buf[0]) {
-    case 'T':
-        memmove(&buf[0], &buf[1], strlen(&buf[1]) + 1); /* Consume the T. */
-        return true;
-    case '\0':
-        return true;
-    case 'W':
-        /* Weekdate Format */
-        return parse_weekdate(buf, time);
+    /* Weekdate Format */
+    if (peek(c, 0) == 'W' && count_digits(c, 1) >= 2)
+        return parse_weekdate(c, time, layout, check_only);
+    if (peek(c, 0) == '-' && peek(c, 1) == 'W' && count_digits(c, 2) >= 2) {
+        skip(c, 1);
+        return parse_weekdate(c, time, layout, check_only);
     }
 
-    /* Ordinal Format */
-    if ((strlen(buf) % 2 == 1) == (strchr(buf, 'T') == NULL))
-        return parse_ordinal(buf, time);
+    /* Year only. */
+    layout->format = ISO8601_FORMAT_NORMAL;
+    layout->truncate = ISO8601_TRUNCATE_YEAR;
+    if (!accept_field(c, '-'))
+        return true;
+
+    /*
+     * Ordinal Format
+     *
+     * The ordinal is three digits, followed by an even number of time
+     * digits. The calendar date always has an even number of digits.
+     */
+    if (count_digits(c, 0) % 2 == 1) {
+        layout->format = ISO8601_FORMAT_ORDINAL;
+        layout->truncate = ISO8601_TRUNCATE_DAY;
+        return parse_ordinal(c, time, check_only);
+    }
 
     /* Standard Format */
-    if (!convert_uint8(buf, 0, 2, 1, 12, "-", &time->month))
+    layout->truncate = ISO8601_TRUNCATE_MONTH;
+    if (!convert_uint8(c, 2, 1, 12, &time->month))
         return false;
 
-    switch (buf[0]) {
-    case 'T':
-        memmove(&buf[0], &buf[1], strlen(&buf[1]) + 1); /* Consume the T. */
-        return true;
-    case '\0':
+    if (!accept_field(c, '-'))
         return true;
+
+    layout->truncate = ISO8601_TRUNCATE_DAY;
+
+    return convert_uint8(c, 2, 1, length_month_days(time->year, time->month),
+                         &time->day);
+}
+
+/*
+ * Parse the decimal, if present, into a fraction of ISO8601_DEC digits.
+ * Returns the number of digits in the input.
+ */
+static size_t parse_decimal(struct cursor *c, uint32_t *num, uint32_t *den)
+{
+    size_t digits;
+
+    *num = 0;
+    *den = 1;
+
+    if (peek(c, 0) != '.')
+        return 0;
+
+    digits = count_digits(c, 1);
+    if (digits == 0)
+        return 0;
+    skip(c, 1);
+
+    for (size_t i = 0; i < digits && i < ISO8601_DEC; i++) {
+        *num = *num * 10 + peek(c, i) - '0';
+        *den *= 10;
     }
 
-    return convert_uint8(buf, 0, 2, 1,
-                         length_month_days(time->year, time->month),
-                         "T", &time->day);
+    skip(c, digits);
+    return digits;
+}
+
+/*
+ * Apply a decimal fraction to the last time component, whose smaller
+ * components are zero. The fraction is exact to the nanosecond.
+ */
+static bool apply_decimal(iso8601_time *time, const uint8_t *last,
+                          uint32_t num, uint32_t den)
+{
+    /* The fraction of the last component, in nanoseconds of that unit. */
+    uint64_t nanos = (uint64_t) num * (1000000000 / den);
+
+    if (time->hour == 24 && num != 0)
+        return false;
+
+    if (last == &time->hour)
+        nanos *= 60 * 60;
+    else if (last == &time->minute)
+        nanos *= 60;
+
+    time->minute += nanos / 60000000000;
+    nanos %= 60000000000;
+    time->second += nanos / 1000000000;
+    nanos %= 1000000000;
+    time->usecond = nanos / 1000;
+    time->nsecond = nanos % 1000;
+    return true;
 }
 
-static bool parse_time(char *buf, double decimal, iso8601_time *time)
+static bool parse_time(struct cursor *c, iso8601_time *time,
+                       iso8601_layout *layout)
 {
+    uint8_t *last;
+    size_t digits;
+    uint32_t num;
+    uint32_t den;
+
     time->hour = 0;
     time->minute = 0;
     time->second = 0;
-    if (buf[0] == '\0')
-        return true;
 
-    /* Convert hours, possibly including decimal. */
-    if (!convert_uint8(buf, 0, 2, 0, 24, ":", &time->hour))
-        return false;
-    if (time->hour == 24 && decimal != 0)
+    /* Convert hours. */
+    if (!convert_uint8(c, 2, 0, 24, &time->hour))
         return false;
-    if (buf[0] == '\0') {
-        time->minute = 60 * decimal;
-        return true;
-    }
+    last = &time->hour;
+    layout->truncate = ISO8601_TRUNCATE_HOUR;
 
-    /* Convert minutes, possibly including decimal. */
-    if (!convert_uint8(buf, 0, 2, 0, time->hour == 24 ? 0 : 59, ":", &time->minute))
-        return false;
-    if (buf[0] == '\0') {
-        time->second = 60 * decimal;
-        return true;
+    /* Convert minutes. */
+    if (accept_field(c, ':')) {
+        if (!convert_uint8(c, 2, 0, time->hour == 24 ? 0 : 59, &time->minute))
+            return false;
+        last = &time->minute;
+        layout->truncate = ISO8601_TRUNCATE_MINUTE;
+
+        /* Convert seconds. */
+        if (accept_field(c, ':')) {
+            if (!convert_uint8(c, 2, 0, time->hour == 24 ? 0 : 60,
+                               &time->second))
+                return false;
+            last = &time->second;
+            layout->truncate = ISO8601_TRUNCATE_SECOND;
+        }
     }
 
-    /* Convert seconds, including decimal. */
-    if (!convert_uint8(buf, 0, 2, 0, time->hour == 24 ? 0 : 60, NULL, &time->second))
-        return false;
-    time->usecond = decimal * 1000000;
-    return true;
+    /* Apply the decimal to the last component. */
+    digits = parse_decimal(c, &num, &den);
+    layout->decimals = digits > UINT8_MAX ? 0 : digits;
+    return apply_decimal(time, last, num, den);
 }
 
-static bool parse_end_timezone(char *buf, iso8601_time *time)
+static bool parse_timezone(struct cursor *c, iso8601_time *time)
 {
     int multiplier = 1;
-    int hoff = 0;
-    int moff = 0;
-    size_t len;
+    int32_t hoff = 0;
+    int32_t moff = 0;
+    char sign = peek(c, 0);
 
-    /* We have a date. */
-    len = strlen(buf);
-    if (len < 1)
-        goto local;
+    /* A sign is only part of the timezone if the hours follow. */
+    if ((sign == '+' || sign == '-') && count_digits(c, 1) < 2)
+        sign = '\0';
 
-    /* Look for Z. */
-    if (buf[len - 1] == 'Z') {
-        buf[len - 1] = '\0';
+    switch (sign) {
+    case 'Z':
+        skip(c, 1);
         time->tzminutes = 0;
         time->localtime = false;
         return true;
-    }
 
-    /* Parse the minutes if specified. */
-    if (len >= 5) {
-        switch (buf[len - 5]) {
-        case '-': /* fallthrough */
-        case '+':
-            if (!convert(&buf[len - 2], 0, 2, 0, 59, NULL, &moff))
-                return false;
-            len -= 2;
-            break;
-        }
-    }
+    case '-':
+        multiplier = -1;
+        /* fallthrough */
+    case '+':
+        skip(c, 1);
 
-    /* Parse the hours. */
-    if (len >= 3) {
-        switch (buf[len - 3]) {
-        case '-':
-            multiplier = -1;
-            /* fallthrough */
-        case '+':
-            if (!convert(&buf[len - 3], 1, 2, 0, 24, NULL, &hoff))
-                return false;
+        /* Parse the hours. */
+        if (!convert(c, 2, 0, 24, &hoff))
+            return false;
 
-            time->tzminutes = ((hoff * 60) + moff) * multiplier;
-            time->localtime = false;
-            return true;
+        /* Parse the minutes if specified. */
+        if (accept_field(c, ':')) {
+            if (!convert(c, 2, 0, 59, &moff))
+                return false;
         }
-    }
 
-local:
-    time->tzminutes = 0; /* TODO: Set the UTC offset? */
-    time->localtime = true;
-    return true;
-}
-
-static void parse_end_decimal(char *buf, double *out)
-{
-    int len = strlen(buf);
-    for (int i = len - 1; i >= 0 && i >= len - ISO8601_DEC; i--) {
-        if (isdigit(buf[i]))
-            continue;
-
-        if (buf[i] != '.')
-            break;
+        time->tzminutes = ((hoff * 60) + moff) * multiplier;
+        time->localtime = false;
+        return true;
 
-        *out = strtod(&buf[i], NULL);
-        buf[i] = '\0';
-        return;
+    default:
+        time->tzminutes = 0; /* TODO: Set the UTC offset? */
+        time->localtime = true;
+        return true;
     }
-
-    *out = 0;
 }
 
-static bool normalize_iso8601(char *buf)
+/* The zone style of a timezone parsed from the first byte, sign. */
+static iso8601_zone zone_style(char sign, const iso8601_time *time)
 {
-    int i = 0, j = 0;
-    int decimals = 0;
+    if (time->localtime)
+        return ISO8601_ZONE_LOCAL;
 
-    do {
-        buf[j] = buf[i];
-
-        switch (buf[j]) {
-        case '-':
-            /*
-             * Handle the weekday case which requires an odd number of digits
-             * after the dash. In the most common case, this number will be 0
-             * or 1. But if 'T' is not present, it can be all the way to the
-             * end of the time section. Take for example, the case of midnight
-             * on January first in local time: 1989W011000000
-             */
-            if (j == 3 && buf[0] == 'W') {
-                int digits;
-                for (digits = 0; buf[i + digits + 1] != '\0'; digits++) {
-                    if (!isdigit(buf[i + digits + 1]))
-                        break;
-                }
-                if (digits % 2 == 1)
-                    continue;
-            }
+    return sign == 'Z' ? ISO8601_ZONE_UTC : ISO8601_ZONE_OFFSET;
+}
 
-            /* - is removed from the date but retained in the TZ. */
-            if (j < 3)
-                continue;
-            break;
+/*
+ * The canonical extended layout, YYYY-MM-DDTHH:MM:SS, is by far the most
+ * common input. Its fields live at fixed offsets, so they can be checked and
+ * converted without any of the layout detection above. The decimal and the
+ * timezone which may follow are handled by the normal code.
+ */
+#define FAST_LEN 19
 
-        case '+':
-            /* + can only appear in the TZ. */
-            if (j < 3)
-                return false;
-            break;
+#if defined(__SSE2__)
+/* Convert each pair of digits in the 16-bit lanes into a number. */
+static __m128i fast_pairs(__m128i digits)
+{
+    const __m128i tens = _mm_and_si128(digits, _mm_set1_epi16(0x00ff));
+    const __m128i ones = _mm_srli_epi16(digits, 8);
 
-        case 'W':
-            /* W can only appear immediately after the year. */
-            if (j != 0)
-                return false;
-            break;
+    return _mm_add_epi16(_mm_mullo_epi16(tens, _mm_set1_epi16(10)), ones);
+}
 
-        case 'Z':
-            /* Z can only come at the end. */
-            if (buf[i + 1] != '\0')
-                return false;
-            break;
+/* Check and convert the first 16 bytes (YYYY-MM-DDTHH:MM) using SSE2. */
+static bool fast_prefix(const char *str, iso8601_time *time)
+{
+    const __m128i layout = _mm_setr_epi8('0', '0', '0', '0', '-', '0', '0',
+                                         '-', '0', '0', 'T', '0', '0', ':',
+                                         '0', '0');
+    const __m128i seps = _mm_setr_epi8(0, 0, 0, 0, -1, 0, 0, -1,
+                                       0, 0, -1, 0, 0, -1, 0, 0);
+    const __m128i in = _mm_loadu_si128((const __m128i *) str);
+    const __m128i digits = _mm_sub_epi8(in, _mm_set1_epi8('0'));
+    __m128i even;
+    __m128i odd;
+    __m128i ok;
+
+    /* Digits must be 0-9 and separators must match the layout exactly. */
+    ok = _mm_cmpeq_epi8(_mm_min_epu8(digits, _mm_set1_epi8(9)), digits);
+    ok = _mm_or_si128(_mm_andnot_si128(seps, ok),
+                      _mm_and_si128(seps, _mm_cmpeq_epi8(in, layout)));
+    if (_mm_movemask_epi8(ok) != 0xffff)
+        return false;
 
-        case ':':
-            continue;
+    /* Fields starting at even offsets land in even, odd offsets in odd. */
+    even = fast_pairs(digits);
+    odd = fast_pairs(_mm_srli_si128(digits, 1));
 
-        case '.':
-            /* Only one permitted. */
-            if (decimals++ > 0)
-                return false;
-            break;
+    time->year = _mm_extract_epi16(even, 0) * 100 + _mm_extract_epi16(even, 1);
+    time->month = _mm_extract_epi16(odd, 2);
+    time->day = _mm_extract_epi16(even, 4);
+    time->hour = _mm_extract_epi16(odd, 5);
+    time->minute = _mm_extract_epi16(even, 7);
+    return true;
+}
+#else
+static int fast_pair(const char *str)
+{
+    if (!is_digit(str[0]) || !is_digit(str[1]))
+        return -1;
 
-        case 'T':
-        case '0':
-        case '1':
-        case '2':
-        case '3':
-        case '4':
-        case '5':
-        case '6':
-        case '7':
-        case '8':
-        case '9':
-        case '\0':
-            break;
+    return (str[0] - '0') * 10 + str[1] - '0';
+}
 
-        default:
-            return false;
-        }
+/* Check and convert the first 16 bytes (YYYY-MM-DDTHH:MM). */
+static bool fast_prefix(const char *str, iso8601_time *time)
+{
+    const int centuries = fast_pair(&str[0]);
+    const int years = fast_pair(&str[2]);
+    const int month = fast_pair(&str[5]);
+    const int day = fast_pair(&str[8]);
+    const int hour = fast_pair(&str[11]);
+    const int minute = fast_pair(&str[14]);
+
+    if ((centuries | years | month | day | hour | minute) < 0)
+        return false;
 
-        j++;
-    } while (buf[i++] != '\0');
+    if (str[4] != '-' || str[7] != '-' || str[10] != 'T' || str[13] != ':')
+        return false;
 
-    buf[j] = '\0';
+    time->year = centuries * 100 + years;
+    time->month = month;
+    time->day = day;
+    time->hour = hour;
+    time->minute = minute;
     return true;
 }
+#endif
 
-static bool parse_year(char *buf, iso8601_time *time)
+static bool parse_fast(struct cursor *c, iso8601_time *out,
+                       iso8601_layout *layout)
 {
-    int multiplier = 1;
-    int digits = 4;
-    int sign = 0;
-    int sep = 0;
+    const char *str = c->str;
+    iso8601_time time = {};
+    struct cursor tmp = *c;
+    size_t digits;
+    uint32_t num;
+    uint32_t den;
+    char sign;
+
+    /* Bail out early on the basic format. */
+    if (count_digits(c, 0) != 4 || peek(c, 4) != '-')
+        return false;
 
-    /* Parse year multiplier. */
-    switch (buf[0]) {
-    case '-':
-        multiplier = -1;
-        /* fallthrough */
-    case '+':
-        sign++;
-        digits = 0;
-        break;
-    default:
-        break;
-    }
+    /* Make sure the whole layout is readable before loading it. */
+    if (strnlen(str, c->len < FAST_LEN ? c->len : FAST_LEN) < FAST_LEN)
+        return false;
 
-    /* Count the number of digits. */
-    for (int i = sign; i > 0; i++) {
-        switch (buf[i]) {
-        case 'W':
-            if (sep >= 2)
-                return false;
-            goto convert;
-
-        case '\0':
-        case ':':
-        case '.':
-        case '+':
-        case 'Z':
-            digits = 4;
-            goto convert;
-
-        case 'T':
-            if (sep != 2)
-                digits = 4;
-            goto convert;
-
-        case '-':
-            sep++;
-            break;
+    if (!fast_prefix(str, &time))
+        return false;
 
-        case '0':
-        case '1':
-        case '2':
-        case '3':
-        case '4':
-        case '5':
-        case '6':
-        case '7':
-        case '8':
-        case '9':
-            if (sep == 0)
-                digits++;
-            break;
+    if (str[16] != ':' || !is_digit(str[17]) || !is_digit(str[18]))
+        return false;
+    time.second = (str[17] - '0') * 10 + str[18] - '0';
 
-        default:
-            return false;
-        }
-    }
+    /* Leave anything unusual, including hour 24, to the normal code. */
+    if (time.month < 1 || time.month > 12)
+        return false;
+    if (time.day < 1 || time.day > length_month_days(time.year, time.month))
+        return false;
+    if (time.hour > 23 || time.minute > 59 || time.second > 60)
+        return false;
 
-convert:
-    /* Convert the year. */
-    if (!convert(buf, sign, digits, 0, -1, "-", &time->year))
+    skip(&tmp, FAST_LEN);
+    digits = parse_decimal(&tmp, &num, &den);
+    apply_decimal(&time, &time.second, num, den);
+
+    sign = peek(&tmp, 0);
+    if (!parse_timezone(&tmp, &time))
         return false;
 
-    time->year *= multiplier;
-    time->month = 1;
-    time->day = 1;
+    layout->format = ISO8601_FORMAT_NORMAL;
+    layout->truncate = ISO8601_TRUNCATE_SECOND;
+    layout->flags = ISO8601_FLAG_NONE;
+    layout->decimals = digits > UINT8_MAX ? 0 : digits;
+    layout->zone = zone_style(sign, &time);
 
+    *c = tmp;
+    *out = time;
     return true;
 }
 
-int iso8601_parse(const char *in, iso8601_time *out)
+/*
+ * Parse the longest timestamp at the cursor, leaving the cursor after it.
+ * The layout receives a description of the input, which is only accurate if
+ * parse_layout() accepts the same input with it. When only checking, weekdates
+ * and ordinals are left unconverted in the output.
+ */
+static int parse_timestamp(struct cursor *c, iso8601_time *out,
+                           iso8601_layout *layout, bool check_only)
 {
-    char buf[ISO8601_MAX + 1];
     iso8601_time time = {};
-    double decimal = 0;
+    char sign;
 
-    if (in == NULL)
-        return EINVAL;
+    /* Try the canonical layout first. */
+    if (parse_fast(c, out, layout))
+        return 0;
 
-    /* Copy the string into a local buffer. */
-    if (strlen(in) < ISO8601_MIN || strlen(in) > ISO8601_MAX)
-        return EINVAL;
-    strcpy(buf, in);
+    layout->flags = ISO8601_FLAG_NONE;
+    layout->decimals = 0;
 
     /* Parse the year. */
-    if (!parse_year(buf, &time))
-        return EINVAL;
-
-    /* Normalize the string. */
-    if (!normalize_iso8601(buf))
-        return EINVAL;
-
-    /* Parse the timezone off the end. */
-    if (!parse_end_timezone(buf, &time))
+    if (!parse_year(c, &time))
         return EINVAL;
 
-    /* Parse the decimal off the end. */
-    parse_end_decimal(buf, &decimal);
-
     /* Parse the date. */
-    if (!parse_date(buf, &time))
+    if (peek(c, 0) != '-')
+        layout->flags |= ISO8601_FLAG_BASIC;
+    if (!parse_date(c, &time, layout, check_only))
         return EINVAL;
 
     /* Parse the time. */
-    if (!parse_time(buf, decimal, &time))
+    if (accept_field(c, 'T')) {
+        if (!parse_time(c, &time, layout))
+            return EINVAL;
+    }
+
+    /* Parse the timezone. */
+    sign = peek(c, 0);
+    if (!parse_timezone(c, &time))
         return EINVAL;
+    layout->zone = zone_style(sign, &time);
 
     *out = time;
     return 0;
 }
+
+static int parse(struct cursor *c, iso8601_time *out, iso8601_layout *layout)
+{
+    return parse_timestamp(c, out, layout, false);
+}
+
+/*
+ * Parse a timestamp using an explicit layout, without any layout detection.
+ * The layout follows the same rules as iso8601_unparse().
+ */
+static int parse_layout(const iso8601_layout *layout, struct cursor *c,
+                        iso8601_time *out)
+{
+    const bool basic = layout->flags & ISO8601_FLAG_BASIC;
+    const iso8601_truncate truncate = layout->truncate;
+    const char dsep = basic ? '\0' : '-';
+    const char tsep = basic ? '\0' : ':';
+    iso8601_time time = {};
+    const uint8_t *last;
+    int32_t wday = 1;
+    int32_t week;
+    uint32_t num;
+    uint32_t den;
+
+    /* Parse the date. */
+    if (!parse_year(c, &time))
+        return EINVAL;
+
+    if (truncate != ISO8601_TRUNCATE_YEAR) {
+        switch (layout->format) {
+        case ISO8601_FORMAT_NORMAL:
+            if (!expect(c, dsep) ||
+                !convert_uint8(c, 2, 1, 12, &time.month))
+                return EINVAL;
+            if (truncate == ISO8601_TRUNCATE_MONTH)
+                break;
+
+            if (!expect(c, dsep) ||
+                !convert_uint8(c, 2, 1,
+                               length_month_days(time.year, time.month),
+                               &time.day))
+                return EINVAL;
+            break;
+
+        case ISO8601_FORMAT_WEEKDATE:
+            if (!expect(c, dsep) || !expect(c, 'W') ||
+                !convert(c, 2, 1, length_year_weeks(time.year), &week))
+                return EINVAL;
+
+            if (truncate != ISO8601_TRUNCATE_WEEK) {
+                if (!expect(c, dsep) || !convert(c, 1, 1, 7, &wday))
+                    return EINVAL;
+            }
+
+            if (!weekdate_to_date(time.year, week, wday,
+                                  &time.year, &time.month, &time.day))
+                return EINVAL;
+            break;
+
+        case ISO8601_FORMAT_ORDINAL:
+            if (!expect(c, dsep) || !parse_ordinal(c, &time, false))
+                return EINVAL;
+            break;
+
+        default:
+            return EINVAL;
+        }
+    }
+
+    /* Parse the time. */
+    if (truncate != ISO8601_TRUNCATE_NONE && truncate < ISO8601_TRUNCATE_HOUR) {
+        if (layout->decimals > 0)
+            return EINVAL;
+    } else {
+        if (!expect(c, 'T') || !convert_uint8(c, 2, 0, 24, &time.hour))
+            return EINVAL;
+        last = &time.hour;
+
+        if (truncate != ISO8601_TRUNCATE_HOUR) {
+            if (!expect(c, tsep) ||
+                !convert_uint8(c, 2, 0, time.hour == 24 ? 0 : 59,
+                               &time.minute))
+                return EINVAL;
+            last = &time.minute;
+
+            if (truncate != ISO8601_TRUNCATE_MINUTE) {
+                if (!expect(c, tsep) ||
+                    !convert_uint8(c, 2, 0, time.hour == 24 ? 0 : 60,
+                                   &time.second))
+                    return EINVAL;
+                last = &time.second;
+            }
+        }
+
+        /* The decimal must have exactly the number of digits specified. */
+        if (layout->decimals > 0) {
+            if (peek(c, 0) != '.' || count_digits(c, 1) != layout->decimals)
+                return EINVAL;
+
+            parse_decimal(c, &num, &den);
+            if (!apply_decimal(&time, last, num, den))
+                return EINVAL;
+        }
+    }
+
+    /* Parse the timezone. */
+    switch (layout->zone) {
+    case ISO8601_ZONE_LOCAL:
+        time.localtime = true;
+        break;
+
+    case ISO8601_ZONE_UTC:
+        if (!expect(c, 'Z'))
+            return EINVAL;
+        break;
+
+    case ISO8601_ZONE_OFFSET:
+        if (peek(c, 0) != '+' && peek(c, 0) != '-')
+            return EINVAL;
+        if (!parse_timezone(c, &time) || time.localtime)
+            return EINVAL;
+        break;
+
+    case ISO8601_ZONE_ANY:
+        if (!parse_timezone(c, &time))
+            return EINVAL;
+        break;
+
+    default:
+        return EINVAL;
+    }
+
+    *out = time;
+    return 0;
+}
+
+/*
+ * Finish parsing a timestamp. If end is NULL, the timestamp must span the
+ * entire input. A length of SIZE_MAX denotes NUL-terminated input.
+ */
+static int finish(const struct cursor *c, size_t len, const char **end)
+{
+    if (end != NULL) {
+        *end = c->str;
+        return 0;
+    }
+
+    if (len == SIZE_MAX ? peek(c, 0) != '\0' : c->len != 0)
+        return EINVAL;
+
+    return 0;
+}
+
+static int parse_whole(const char *in, size_t len, const char **end,
+                       iso8601_time *out)
+{
+    struct cursor c = { in, len };
+    iso8601_layout layout;
+    iso8601_time time;
+
+    if (in == NULL)
+        return EINVAL;
+
+    if (parse(&c, &time, &layout) != 0)
+        return EINVAL;
+
+    if (finish(&c, len, end) != 0)
+        return EINVAL;
+
+    *out = time;
+    return 0;
+}
+
+int iso8601_parse(const char *in, iso8601_time *out)
+{
+    return parse_whole(in, SIZE_MAX, NULL, out);
+}
+
+int iso8601_parse_n(const char *in, size_t len, const char **end,
+                    iso8601_time *out)
+{
+    return parse_whole(in, len, end, out);
+}
+
+int iso8601_parse_normalized(const char *in, size_t len, const char **end,
+                             iso8601_time *out)
+{
+    iso8601_time time;
+    int err;
+
+    err = parse_whole(in, len, end, &time);
+    if (err != 0)
+        return err;
+
+    normalize(&time);
+    *out = time;
+    return 0;
+}
+
+int iso8601_validate(const char *in, size_t len)
+{
+    struct cursor c = { in, len };
+    iso8601_layout layout;
+    iso8601_time time;
+
+    if (in == NULL)
+        return EINVAL;
+
+    if (parse_timestamp(&c, &time, &layout, true) != 0)
+        return EINVAL;
+
+    return finish(&c, len, NULL);
+}
+
+int iso8601_parse_layout(const iso8601_layout *layout, const char *in,
+                         size_t len, const char **end, iso8601_time *out)
+{
+    struct cursor c = { in, len };
+    iso8601_time time;
+
+    if (layout == NULL || in == NULL)
+        return EINVAL;
+
+    if (parse_layout(layout, &c, &time) != 0)
+        return EINVAL;
+
+    if (finish(&c, len, end) != 0)
+        return EINVAL;
+
+    *out = time;
+    return 0;
+}
+
+/* Convert a parsed time into the number of units since the epoch. */
+static int to_epoch(const iso8601_time *time, iso8601_unit unit,
+                    const int16_t *localzone, int64_t *out)
+{
+    static const int64_t scale[] = {
+        [ISO8601_UNIT_SECOND] = 1,
+        [ISO8601_UNIT_MILLI] = 1000,
+        [ISO8601_UNIT_MICRO] = 1000000,
+        [ISO8601_UNIT_NANO] = 1000000000,
+    };
+    int64_t fraction;
+    int64_t seconds;
+    int16_t zone;
+    int64_t val;
+
+    if (!time->localtime)
+        zone = time->tzminutes;
+    else if (localzone != NULL)
+        zone = *localzone;
+    else
+        return EDOM;
+
+    /* This can't overflow: the year has at most nine digits. */
+    seconds = days_from_civil(time->year, time->month, time->day) * 86400 +
+              time->hour * 3600 + (time->minute - zone) * 60 + time->second;
+    fraction = ((int64_t) time->usecond * 1000 + time->nsecond) /
+               (1000000000 / scale[unit]);
+
+    /* Before the epoch, borrow the fraction so that INT64_MIN is reachable. */
+    if (seconds < 0 && fraction > 0) {
+        seconds++;
+        fraction -= scale[unit];
+    }
+
+    if (__builtin_mul_overflow(seconds, scale[unit], &val) ||
+        __builtin_add_overflow(val, fraction, &val))
+        return ERANGE;
+
+    *out = val;
+    return 0;
+}
+
+int iso8601_parse_epoch(const char *in, size_t len, const char **end,
+                        iso8601_unit unit, const int16_t *localzone,
+                        int64_t *out)
+{
+    iso8601_time time;
+    int err;
+
+    if (unit < ISO8601_UNIT_SECOND || unit > ISO8601_UNIT_NANO || out == NULL)
+        return EINVAL;
+
+    err = parse_whole(in, len, end, &time);
+    if (err != 0)
+        return err;
+
+    return to_epoch(&time, unit, localzone, out);
+}
+
+/* Add an exact number of nanoseconds to the fields below weeks. */
+static void spread_nanos(iso8601_duration *d, uint64_t nanos)
+{
+    d->days += nanos / 86400000000000;
+    nanos %= 86400000000000;
+    d->hours += nanos / 3600000000000;
+    nanos %= 3600000000000;
+    d->minutes += nanos / 60000000000;
+    nanos %= 60000000000;
+    d->seconds += nanos / 1000000000;
+    nanos %= 1000000000;
+    d->useconds = nanos / 1000;
+    d->nseconds = nanos % 1000;
+}
+
+/* Parse the designator format: nYnMnWnDTnHnMnS, in that order. */
+static bool parse_designators(struct cursor *c, iso8601_duration *out)
+{
+    static const struct {
+        char designator;
+        uint64_t nanos; /* The length of the unit, if it is exact. */
+    } units[] = {
+        { 'Y', 0 },
+        { 'M', 0 },
+        { 'W', 604800000000000 },
+        { 'D', 86400000000000 },
+        { 'H', 3600000000000 },
+        { 'M', 60000000000 },
+        { 'S', 1000000000 },
+    };
+    uint32_t *const fields[] = {
+        &out->years, &out->months, &out->weeks, &out->days,
+        &out->hours, &out->minutes, &out->seconds,
+    };
+    struct cursor date = *c;
+    bool dated = false;
+    bool found = false;
+
+    for (size_t i = 0; i < sizeof(units) / sizeof(*units); i++) {
+        struct cursor tmp = *c;
+        size_t digits;
+        uint32_t value;
+        uint32_t num;
+        uint32_t den;
+
+        /* The time components follow a T. */
+        if (fields[i] == &out->hours) {
+            if (peek(c, 0) != 'T')
+                break;
+            date = *c;
+            dated = found;
+            found = false;
+            skip(c, 1);
+            tmp = *c;
+        }
+
+        /* Each component may be omitted. */
+        digits = count_digits(&tmp, 0);
+        if (digits == 0 || !convert_uint32(&tmp, digits, &value))
+            continue;
+        digits = parse_decimal(&tmp, &num, &den);
+        if (!expect(&tmp, units[i].designator))
+            continue;
+
+        *c = tmp;
+        *fields[i] = value;
+        found = true;
+
+        /* Only the last component may have a decimal. */
+        if (digits > 0) {
+            if (units[i].nanos == 0)
+                return false;
+
+            spread_nanos(out, num * (units[i].nanos / den));
+            break;
+        }
+    }
+
+    /* A T without any time components isn't part of the duration. */
+    if (dated && !found) {
+        *c = date;
+        return true;
+    }
+
+    return found;
+}
+
+/* Parse the alternative format: YYYY-MM-DDThh:mm:ss or YYYYMMDDThhmmss. */
+static bool parse_alternative(struct cursor *c, iso8601_duration *out)
+{
+    const char dsep = peek(c, 4) == '-' ? '-' : '\0';
+    const char tsep = dsep == '-' ? ':' : '\0';
+    int32_t years;
+    int32_t months;
+    int32_t days;
+    int32_t hours = 0;
+    int32_t minutes = 0;
+    int32_t seconds = 0;
+    uint32_t num;
+    uint32_t den;
+
+    /* The values may not exceed their carry-over points. */
+    if (!convert(c, 4, 0, 9999, &years) || !expect(c, dsep) ||
+        !convert(c, 2, 0, 12, &months) || !expect(c, dsep) ||
+        !convert(c, 2, 0, 30, &days))
+        return false;
+
+    if (peek(c, 0) == 'T') {
+        skip(c, 1);
+        if (!convert(c, 2, 0, 24, &hours) || !expect(c, tsep) ||
+            !convert(c, 2, 0, 59, &minutes) || !expect(c, tsep) ||
+            !convert(c, 2, 0, 59, &seconds))
+            return false;
+
+        parse_decimal(c, &num, &den);
+        spread_nanos(out, num * (1000000000 / den));
+    }
+
+    out->years = years;
+    out->months = months;
+    out->days = days;
+    out->hours = hours;
+    out->minutes = minutes;
+    out->seconds = seconds;
+    return true;
+}
+
+static bool parse_duration(struct cursor *c, iso8601_duration *out)
+{
+    iso8601_duration duration = {};
+
+    if (peek(c, 0) == '-') {
+        duration.negative = true;
+        skip(c, 1);
+    }
+
+    if (!expect(c, 'P'))
+        return false;
+
+    /* The alternative format starts with a four digit year. */
+    if ((count_digits(c, 0) == 4 && peek(c, 4) == '-') ||
+        (count_digits(c, 0) == 8 && peek(c, 8) != '.' &&
+         peek(c, 8) != 'Y' && peek(c, 8) != 'M' &&
+         peek(c, 8) != 'W' && peek(c, 8) != 'D')) {
+        if (!parse_alternative(c, &duration))
+            return false;
+    } else if (!parse_designators(c, &duration)) {
+        return false;
+    }
+
+    *out = duration;
+    return true;
+}
+
+int iso8601_parse_duration(const char *in, size_t len, const char **end,
+                           iso8601_duration *out)
+{
+    struct cursor c = { in, len };
+    iso8601_duration duration;
+
+    if (in == NULL || out == NULL)
+        return EINVAL;
+
+    if (!parse_duration(&c, &duration))
+        return EINVAL;
+
+    if (finish(&c, len, end) != 0)
+        return EINVAL;
+
+    *out = duration;
+    return 0;
+}
+
+/* Whether a duration starts at the cursor. */
+static bool is_duration(const struct cursor *c)
+{
+    return peek(c, 0) == 'P' || (peek(c, 0) == '-' && peek(c, 1) == 'P');
+}
+
+/*
+ * Find where each component of a timestamp starts: the year, the fields of
+ * the date and those of the time. The timestamp must be written exactly as
+ * its layout describes. Returns the number of components.
+ */
+static size_t split_components(const char *str, size_t len,
+                               const iso8601_layout *layout,
+                               size_t offsets[6])
+{
+    static const uint8_t widths[][2] = {
+        [ISO8601_FORMAT_NORMAL] = { 2, 2 },     /* MM, DD */
+        [ISO8601_FORMAT_WEEKDATE] = { 3, 1 },   /* Www, D */
+        [ISO8601_FORMAT_ORDINAL] = { 3, 0 },    /* DDD */
+    };
+    const size_t sep = layout->flags & ISO8601_FLAG_BASIC ? 0 : 1;
+    const iso8601_truncate truncate =
+        layout->truncate == ISO8601_TRUNCATE_NONE ?
+        ISO8601_TRUNCATE_SECOND : layout->truncate;
+    struct cursor c = { str, len };
+    iso8601_time time;
+    size_t pos;
+    size_t n = 0;
+
+    offsets[n++] = 0;
+    if (!parse_year(&c, &time))
+        return 0;
+    pos = c.str - str;
+
+    for (size_t i = 0; i < 2 && truncate > ISO8601_TRUNCATE_YEAR + i; i++) {
+        if (widths[layout->format][i] == 0)
+            break;
+
+        offsets[n++] = pos + sep;
+        pos += sep + widths[layout->format][i];
+    }
+
+    for (int i = ISO8601_TRUNCATE_HOUR; i <= truncate; i++) {
+        pos += i == ISO8601_TRUNCATE_HOUR ? 1 : sep;
+        offsets[n++] = pos;
+        pos += 2;
+    }
+
+    return n;
+}
+
+/* Whether two layouts write the same components in the same style. */
+static bool same_layout(const iso8601_layout *a, const iso8601_layout *b)
+{
+    return a->format == b->format && a->truncate == b->truncate &&
+           !((a->flags ^ b->flags) & ISO8601_FLAG_BASIC);
+}
+
+/*
+ * Parse the end of an interval, which may omit its leading components. These
+ * are then taken from the start, so 2007-12-14T13:30/15:30 ends at
+ * 2007-12-14T15:30. The end is aligned with the start by whole components:
+ * it must be laid out like the start and have the same last component, and
+ * each of its fields must be written in full. Without a timezone, it is in
+ * that of the start.
+ */
+static bool parse_interval_end(struct cursor *c, const char *start,
+                               size_t slen, iso8601_time *out)
+{
+    struct cursor full = *c;
+    struct cursor strict;
+    struct cursor tmp;
+    iso8601_layout layout;
+    iso8601_layout merged;
+    iso8601_time check;
+    iso8601_time first;
+    iso8601_time time;
+    size_t offsets[6];
+    char buf[64];
+    size_t token;
+    size_t n = 0;
+    bool whole;
+
+    /* Find the components of the start. */
+    tmp = (struct cursor) { start, slen };
+    if (parse(&tmp, &first, &layout) == 0 && tmp.str == start + slen) {
+        tmp = (struct cursor) { start, slen };
+        if (parse_layout(&layout, &tmp, &time) == 0 &&
+            tmp.str == start + slen)
+            n = split_components(start, slen, &layout, offsets);
+    }
+
+    /*
+     * A complete end is usually laid out like the start. If it isn't, it
+     * may be an abbreviation after all, as 1530 is after 20071214T1330.
+     */
+    whole = parse(&full, out, &merged) == 0;
+    if (whole && (n == 0 || same_layout(&merged, &layout))) {
+        *c = full;
+        return true;
+    }
+
+    /* All of the end must be consumed, whichever components it gives. */
+    for (token = 0; is_stamp(peek(c, token)); token++)
+        continue;
+
+    /*
+     * Try the end in place of each run of trailing components, longest
+     * first: otherwise 2008-02-15/03-14 would end on 2008-02-03 at -14:00.
+     */
+    for (size_t i = 1; i < n && token > 0; i++) {
+        const size_t plen = offsets[i];
+        size_t elen;
+
+        memcpy(buf, start, plen);
+        for (elen = 0; plen + elen < sizeof(buf); elen++) {
+            buf[plen + elen] = peek(c, elen);
+            if (buf[plen + elen] == '\0')
+                break;
+        }
+
+        /* Check it strictly against the layout of the start. */
+        tmp = (struct cursor) { buf, plen + elen };
+        if (parse(&tmp, &time, &merged) != 0 || tmp.str - buf - plen < token)
+            continue;
+
+        merged.format = layout.format;
+        merged.truncate = layout.truncate;
+        merged.flags = layout.flags;
+        strict = (struct cursor) { buf, plen + elen };
+        if (parse_layout(&merged, &strict, &check) != 0 ||
+            strict.str != tmp.str)
+            continue;
+
+        if (merged.zone == ISO8601_ZONE_LOCAL) {
+            time.localtime = first.localtime;
+            time.tzminutes = first.tzminutes;
+        }
+
+        skip(c, tmp.str - buf - plen);
+        *out = time;
+        return true;
+    }
+
+    if (whole)
+        *c = full;
+    return whole;
+}
+
+/* The ways of writing an interval. */
+enum form {
+    FORM_INVALID = 0,
+    FORM_START_END,
+    FORM_START_DURATION,
+    FORM_DURATION_END,
+};
+
+/* Parse the two parts of an interval, setting only those which are given. */
+static enum form parse_parts(struct cursor *c, iso8601_time *start,
+                             iso8601_duration *duration, iso8601_time *stop)
+{
+    const char *const begin = c->str;
+    iso8601_layout layout;
+
+    if (is_duration(c)) {
+        if (!parse_duration(c, duration) || !expect(c, '/') ||
+            parse(c, stop, &layout) != 0)
+            return FORM_INVALID;
+
+        return FORM_DURATION_END;
+    }
+
+    if (parse(c, start, &layout) != 0 || !expect(c, '/'))
+        return FORM_INVALID;
+
+    if (is_duration(c)) {
+        if (!parse_duration(c, duration))
+            return FORM_INVALID;
+
+        return FORM_START_DURATION;
+    }
+
+    if (!parse_interval_end(c, begin, c->str - 1 - begin, stop))
+        return FORM_INVALID;
+
+    return FORM_START_END;
+}
+
+int iso8601_parse_interval(const char *in, size_t len, const char **end,
+                           const int16_t *localzone, iso8601_interval *out)
+{
+    struct cursor c = { in, len };
+    iso8601_interval interval = {};
+    iso8601_duration duration;
+    int64_t stop;
+    int err;
+
+    if (in == NULL || out == NULL)
+        return EINVAL;
+
+    switch (parse_parts(&c, &interval.start, &duration, &interval.end)) {
+    case FORM_START_END:
+        err = 0;
+        break;
+
+    case FORM_START_DURATION:
+        interval.end = interval.start;
+        err = iso8601_add_duration(&interval.end, &duration);
+        break;
+
+    case FORM_DURATION_END:
+        duration.negative = !duration.negative;
+        interval.start = interval.end;
+        err = iso8601_add_duration(&interval.start, &duration);
+        break;
+
+    default:
+        return EINVAL;
+    }
+    if (err != 0)
+        return err;
+
+    if (finish(&c, len, end) != 0)
+        return EINVAL;
+
+    /* Precompute the span, so that containment is an integer comparison. */
+    err = to_epoch(&interval.start, ISO8601_UNIT_MICRO, localzone,
+                   &interval.start_us);
+    if (err == 0)
+        err = to_epoch(&interval.end, ISO8601_UNIT_MICRO, localzone, &stop);
+    if (err != 0)
+        return err;
+
+    if (stop < interval.start_us)
+        return EINVAL;
+    if (__builtin_sub_overflow(stop, interval.start_us, &interval.span_us))
+        return ERANGE;
+
+    *out = interval;
+    return 0;
+}
+
+/* Get the exact time from start to stop, which must not be negative. */
+static int difference(const iso8601_time *start, const iso8601_time *stop,
+                      const int16_t *localzone, iso8601_duration *out)
+{
+    int64_t seconds;
+    int64_t nanos;
+    int64_t from;
+    int64_t to;
+    int err;
+
+    err = to_epoch(start, ISO8601_UNIT_SECOND, localzone, &from);
+    if (err == 0)
+        err = to_epoch(stop, ISO8601_UNIT_SECOND, localzone, &to);
+    if (err != 0)
+        return err;
+
+    seconds = to - from;
+    nanos = (int64_t) stop->usecond * 1000 + stop->nsecond -
+            (int64_t) start->usecond * 1000 - start->nsecond;
+    if (nanos < 0) {
+        nanos += 1000000000;
+        seconds--;
+    }
+
+    if (seconds < 0)
+        return EINVAL;
+    if (seconds / 86400 > UINT32_MAX)
+        return ERANGE;
+
+    *out = (iso8601_duration) { .days = seconds / 86400 };
+    spread_nanos(out, (uint64_t) (seconds % 86400) * 1000000000 + nanos);
+    return 0;
+}
+
+/* Multiply a duration by a whole number, as long as its fields still fit. */
+static bool scale_duration(iso8601_duration *d, uint32_t times)
+{
+    uint32_t *const fields[] = {
+        &d->years, &d->months, &d->weeks, &d->days,
+        &d->hours, &d->minutes, &d->seconds,
+    };
+    const uint64_t nanos =
+        ((uint64_t) d->useconds * 1000 + d->nseconds) * times;
+
+    for (size_t i = 0; i < sizeof(fields) / sizeof(*fields); i++) {
+        if (__builtin_mul_overflow(*fields[i], times, fields[i]))
+            return false;
+    }
+
+    if (__builtin_add_overflow(d->seconds, nanos / 1000000000, &d->seconds))
+        return false;
+
+    d->useconds = nanos % 1000000000 / 1000;
+    d->nseconds = nanos % 1000;
+    return true;
+}
+
+int iso8601_parse_recurrence(const char *in, size_t len, const char **end,
+                             const int16_t *localzone,
+                             iso8601_recurrence *out)
+{
+    iso8601_recurrence recurrence = { .count = -1 };
+    const iso8601_duration *period = &recurrence.period;
+    struct cursor c = { in, len };
+    iso8601_duration back;
+    iso8601_time stop;
+    size_t digits;
+    int err;
+
+    if (in == NULL || out == NULL || !expect(&c, 'R'))
+        return EINVAL;
+
+    /* The number of occurrences, if bounded. */
+    digits = count_digits(&c, 0);
+    if (digits > 18)
+        return EINVAL;
+    if (digits > 0) {
+        recurrence.count = 0;
+        for (size_t i = 0; i < digits; i++)
+            recurrence.count = recurrence.count * 10 + peek(&c, i) - '0';
+        skip(&c, digits);
+    }
+
+    if (!expect(&c, '/'))
+        return EINVAL;
+
+    switch (parse_parts(&c, &recurrence.start, &recurrence.period, &stop)) {
+    case FORM_START_END:
+        err = difference(&recurrence.start, &stop, localzone,
+                         &recurrence.period);
+        break;
+
+    case FORM_START_DURATION:
+        err = 0;
+        break;
+
+    case FORM_DURATION_END:
+        /* Count back from the end of the last occurrence. */
+        if (recurrence.count < 0)
+            return EINVAL;
+
+        back = recurrence.period;
+        back.negative = !back.negative;
+        if (recurrence.count > UINT32_MAX ||
+            !scale_duration(&back, recurrence.count))
+            return ERANGE;
+
+        recurrence.start = stop;
+        err = iso8601_add_duration(&recurrence.start, &back);
+        break;
+
+    default:
+        return EINVAL;
+    }
+    if (err != 0)
+        return err;
+
+    if (finish(&c, len, end) != 0)
+        return EINVAL;
+
+    /* Occurrences must move forwards, or seeking would be meaningless. */
+    if (period->negative ||
+        (period->years | period->months | period->weeks | period->days |
+         period->hours | period->minutes | period->seconds |
+         period->useconds | period->nseconds) == 0)
+        return EINVAL;
+
+    if (!recurrence.start.localtime)
+        recurrence.tzminutes = recurrence.start.tzminutes;
+    else if (localzone != NULL)
+        recurrence.tzminutes = *localzone;
+    else
+        return EDOM;
+
+    *out = recurrence;
+    return 0;
+}
+
+/*
+ * Whether a layout may be remembered. After a year or a month, the generic
+ * parser reads -hh as the next date field, so it never agrees with an offset.
+ */
+static bool learnable(const iso8601_layout *layout)
+{
+    if (layout->zone != ISO8601_ZONE_OFFSET)
+        return true;
+
+    return layout->format != ISO8601_FORMAT_NORMAL ||
+           (layout->truncate != ISO8601_TRUNCATE_YEAR &&
+            layout->truncate != ISO8601_TRUNCATE_MONTH);
+}
+
+static bool same_time(const iso8601_time *a, const iso8601_time *b)
+{
+    return a->year == b->year && a->month == b->month && a->day == b->day &&
+           a->hour == b->hour && a->minute == b->minute &&
+           a->second == b->second && a->usecond == b->usecond &&
+           a->nsecond == b->nsecond && a->localtime == b->localtime &&
+           a->tzminutes == b->tzminutes;
+}
+
+/*
+ * Whether a timestamp could continue at the cursor. When the caller accepts
+ * a prefix, a layout match is only trusted if the generic parser would also
+ * have stopped here.
+ */
+static bool continues(const struct cursor *c)
+{
+    return is_stamp(peek(c, 0));
+}
+
+int iso8601_parser_parse(iso8601_parser *parser, const char *in, size_t len,
+                         const char **end, iso8601_time *out)
+{
+    struct cursor c = { in, len };
+    iso8601_layout layout;
+    iso8601_time check;
+    iso8601_time time;
+
+    if (parser == NULL || in == NULL)
+        return EINVAL;
+
+    /* Try the layout of the last timestamp. */
+    if (parser->learned && parse_layout(&parser->layout, &c, &time) == 0 &&
+        (end != NULL ? !continues(&c) : finish(&c, len, NULL) == 0)) {
+        parser->hits++;
+        finish(&c, len, end);
+        *out = time;
+        return 0;
+    }
+
+    /* Fall back to detecting the layout. */
+    parser->misses++;
+    c = (struct cursor) { in, len };
+    if (parse(&c, &time, &layout) != 0 || finish(&c, len, end) != 0)
+        return EINVAL;
+
+    /* Remember the layout only if it reproduces this result exactly. */
+    if (learnable(&layout)) {
+        struct cursor tmp = { in, len };
+
+        if (parse_layout(&layout, &tmp, &check) == 0 && tmp.str == c.str &&
+            same_time(&check, &time)) {
+            parser->layout = layout;
+            parser->learned = true;
+        }
+    }
+
+    *out = time;
+    return 0;
+}
+
+/*
+ * The parser never looks past a byte which can't be part of a timestamp, so
+ * the bytes before it decide the result. Only those that straddle a chunk
+ * boundary are copied.
+ */
+int iso8601_push_parse(iso8601_push_parser *parser, const char *in, size_t len,
+                       size_t *consumed, iso8601_time *out)
+{
+    size_t lf = 0;
+    size_t stamp;
+    int err;
+
+    if (parser == NULL || (in == NULL && len > 0) || consumed == NULL ||
+        out == NULL)
+        return EINVAL;
+
+    /* A LF right after a CR delimiter belongs to it. */
+    if (parser->cr && len > 0) {
+        parser->cr = false;
+        if (in[0] == '\n') {
+            lf = 1;
+            in++;
+            len--;
+        }
+    }
+
+    for (stamp = 0; stamp < len && is_stamp(in[stamp]); stamp++)
+        continue;
+
+    /* The timestamp may continue in the next chunk. */
+    if (stamp == len) {
+        if (len > sizeof(parser->buf) - parser->len)
+            parser->overflow = true;
+        else if (len > 0) {
+            memcpy(&parser->buf[parser->len], in, len);
+            parser->len += len;
+        }
+
+        *consumed = lf + len;
+        return EAGAIN;
+    }
+
+    /* The delimiter goes with the timestamp it ends. */
+    *consumed = lf + stamp + 1;
+    parser->cr = in[stamp] == '\r';
+    if (parser->overflow)
+        err = EINVAL;
+    else if (parser->len == 0)
+        err = parse_whole(in, stamp, NULL, out);
+    else if (stamp > sizeof(parser->buf) - parser->len)
+        err = EINVAL;
+    else {
+        memcpy(&parser->buf[parser->len], in, stamp);
+        err = parse_whole(parser->buf, parser->len + stamp, NULL, out);
+    }
+
+    parser->len = 0;
+    parser->overflow = false;
+    return err;
+}
+
+int iso8601_push_finish(iso8601_push_parser *parser, iso8601_time *out)
+{
+    int err;
+
+    if (parser == NULL || out == NULL)
+        return EINVAL;
+
+    parser->cr = false;
+    if (parser->len == 0 && !parser->overflow)
+        return ENOENT;
+
+    err = parser->overflow ? EINVAL :
+          parse_whole(parser->buf, parser->len, NULL, out);
+    parser->len = 0;
+    parser->overflow = false;
+    return err;
+}
+
+/* Whether a byte belongs to a word, which a timestamp must not be part of. */
+static bool is_word(char c)
+{
+    return is_class(c, CLASS_WORD);
+}
+
+/* Is pos the end of the text? A length of SIZE_MAX denotes a NUL. */
+static bool scan_end(const char *in, size_t len, size_t pos)
+{
+    return len == SIZE_MAX ? in[pos] == '\0' : pos >= len;
+}
+
+/*
+ * Find the next anchor at or after pos, or the end of the text. Every
+ * timestamp the scanner accepts has either a dash after its four digit year
+ * or a T after its basic date. NUL-terminated text is searched a byte at a
+ * time, so that nothing past the NUL is read.
+ */
+static size_t scan_anchor(const char *in, size_t len, size_t pos)
+{
+#if defined(__SSE2__)
+    const __m128i dash = _mm_set1_epi8('-');
+    const __m128i t = _mm_set1_epi8('T');
+
+    for (; len != SIZE_MAX && len - pos >= 16; pos += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) &in[pos]);
+        const int mask = _mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, dash), _mm_cmpeq_epi8(v, t)));
+
+        if (mask != 0)
+            return pos + __builtin_ctz(mask);
+    }
+#endif
+
+    for (; !scan_end(in, len, pos); pos++) {
+        if (in[pos] == '-' || in[pos] == 'T')
+            break;
+    }
+
+    return pos;
+}
+
+/*
+ * Find the start of the timestamp anchored at pos, which may not begin
+ * before min. Returns SIZE_MAX if the anchor doesn't follow a date.
+ */
+static size_t scan_start(const char *in, size_t pos, size_t min)
+{
+    size_t digits = 0;
+    size_t start;
+
+    while (digits < 9 && digits < pos - min && is_digit(in[pos - digits - 1]))
+        digits++;
+
+    start = pos - digits;
+    if (start > 0 && is_word(in[start - 1]))
+        return SIZE_MAX;
+
+    switch (in[pos]) {
+    case '-':
+        return digits == 4 ? start : SIZE_MAX;
+    default:
+        return digits == 7 || digits == 8 ? start : SIZE_MAX;
+    }
+}
+
+int iso8601_scan(const char *in, size_t len, size_t *pos,
+                 iso8601_match *match)
+{
+    size_t anchor;
+
+    if (in == NULL || pos == NULL || match == NULL)
+        return EINVAL;
+
+    if (len != SIZE_MAX && *pos > len)
+        return EINVAL;
+
+    for (anchor = scan_anchor(in, len, *pos); !scan_end(in, len, anchor);
+         anchor = scan_anchor(in, len, anchor + 1)) {
+        const size_t start = scan_start(in, anchor, *pos);
+        iso8601_layout layout;
+        iso8601_time time;
+        struct cursor c;
+        size_t end;
+
+        if (start == SIZE_MAX)
+            continue;
+
+        c = (struct cursor) { &in[start], len - start };
+        if (parse(&c, &time, &layout) != 0)
+            continue;
+
+        /* The timestamp must extend past its anchor and end a word. */
+        end = c.str - in;
+        if (end <= anchor || (end < len && is_word(in[end])))
+            continue;
+
+        match->offset = start;
+        match->length = end - start;
+        match->time = time;
+        *pos = end;
+        return 0;
+    }
+
+    *pos = anchor;
+    return ENOENT;
+}
+
+int iso8601_parse_batch(const char *const *in, const size_t *lens, size_t n,
+                        iso8601_time *out, int *status)
+{
+    int ret = 0;
+
+    if (n > 0 && (in == NULL || out == NULL))
+        return EINVAL;
+
+    for (size_t i = 0; i < n; i++) {
+        int err;
+
+        err = parse_whole(in[i], lens ? lens[i] : SIZE_MAX, NULL, &out[i]);
+        if (status != NULL)
+            status[i] = err;
+        if (err != 0)
+            ret = EINVAL;
+    }
+
+    return ret;
+}
+
+/* Parse a single cell of a column and scatter it into the output columns. */
+static int parse_cell(const char *data, int64_t start, int64_t end,
+                      const iso8601_columns *out, size_t i)
+{
+    iso8601_time time;
+
+    if (start < 0 || end < start)
+        return EINVAL;
+
+    if (parse_whole(&data[start], end - start, NULL, &time) != 0)
+        return EINVAL;
+
+    if (out->year != NULL)
+        out->year[i] = time.year;
+    if (out->month != NULL)
+        out->month[i] = time.month;
+    if (out->day != NULL)
+        out->day[i] = time.day;
+    if (out->hour != NULL)
+        out->hour[i] = time.hour;
+    if (out->minute != NULL)
+        out->minute[i] = time.minute;
+    if (out->second != NULL)
+        out->second[i] = time.second;
+    if (out->usecond != NULL)
+        out->usecond[i] = time.usecond;
+    if (out->localtime != NULL)
+        out->localtime[i] = time.localtime;
+    if (out->tzminutes != NULL)
+        out->tzminutes[i] = time.tzminutes;
+    if (out->nsecond != NULL)
+        out->nsecond[i] = time.nsecond;
+
+    return 0;
+}
+
+int iso8601_parse_column32(const char *data, const int32_t *offsets,
+                           size_t n, const iso8601_columns *out, int *status)
+{
+    int ret = 0;
+
+    if (n > 0 && (data == NULL || offsets == NULL || out == NULL))
+        return EINVAL;
+
+    for (size_t i = 0; i < n; i++) {
+        int err = parse_cell(data, offsets[i], offsets[i + 1], out, i);
+        if (status != NULL)
+            status[i] = err;
+        if (err != 0)
+            ret = EINVAL;
+    }
+
+    return ret;
+}
+
+int iso8601_parse_column64(const char *data, const int64_t *offsets,
+                           size_t n, const iso8601_columns *out, int *status)
+{
+    int ret = 0;
+
+    if (n > 0 && (data == NULL || offsets == NULL || out == NULL))
+        return EINVAL;
+
+    for (size_t i = 0; i < n; i++) {
+        int err = parse_cell(data, offsets[i], offsets[i + 1], out, i);
+        if (status != NULL)
+            status[i] = err;
+        if (err != 0)
+            ret = EINVAL;
+    }
+
+    return ret;
+}
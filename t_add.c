@@ -21,6 +21,7 @@
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
 
 struct xform {
     iso8601_time before;
@@ -187,12 +188,115 @@ static const struct {
     {}
 };
 
+/* Express a single call to one of the iso8601_add_*() functions as a duration. */
+static iso8601_duration
+as_duration(const char *name, int increment)
+{
+    iso8601_duration duration = { .negative = increment < 0 };
+    const uint32_t value = increment < 0 ? -(int64_t) increment : increment;
+
+    if (strcmp(name, "years") == 0)
+        duration.years = value;
+    else if (strcmp(name, "months") == 0)
+        duration.months = value;
+    else if (strcmp(name, "days") == 0)
+        duration.days = value;
+    else if (strcmp(name, "hours") == 0)
+        duration.hours = value;
+    else if (strcmp(name, "minutes") == 0)
+        duration.minutes = value;
+    else if (strcmp(name, "seconds") == 0)
+        duration.seconds = value;
+    else {
+        duration.seconds = value / 1000000;
+        duration.useconds = value % 1000000;
+    }
+
+    return duration;
+}
+
+/* A duration must have the same effect as the iso8601_add_*() functions. */
+static void
+test_duration(void)
+{
+    static const struct {
+        iso8601_time before;
+        iso8601_duration duration;
+        iso8601_time after;
+    } data[] = {
+        {{2000, 1, 31}, { .months = 1 }, {2000, 3, 2}},
+        {{2001, 1, 31}, { .months = 1 }, {2001, 3, 3}},
+        {{2000, 2, 29}, { .years = 1 }, {2001, 3, 1}},
+        {{2000, 1, 1}, { .weeks = 1, .days = 1 }, {2000, 1, 9}},
+        {{2000, 1, 1}, { .hours = 36, .negative = true },
+         {1999, 12, 30, 12}},
+        {{2000, 1, 1, 0, 0, 0, 1, false, 0, 1},
+         { .useconds = 1, .nseconds = 2, .negative = true },
+         {1999, 12, 31, 23, 59, 59, 999999, false, 0, 999}},
+        {{2000, 12, 31, 23, 59, 60}, { .seconds = 1 }, {2001, 1, 1, 0, 0, 1}},
+        {{2000, 1, 1, 24}, {}, {2000, 1, 2}},
+        {{2000, 1, 1}, { 1, 2, 3, 4, 5, 6, 7, 8, 9 },
+         {2001, 3, 26, 5, 6, 7, 8, false, 0, 9}},
+    };
+    iso8601_time time;
+
+    for (size_t i = 0; i < sizeof(data) / sizeof(*data); i++) {
+        time = data[i].before;
+        assert(iso8601_add_duration(&time, &data[i].duration) == 0);
+        assert(memcmp(&time, &data[i].after, sizeof(time)) == 0);
+    }
+
+    /* Compare against the individual functions. */
+    srand(0);
+    for (int i = 0; i < 100000; i++) {
+        iso8601_duration duration = {
+            rand() % 100, rand() % 100, rand() % 100, rand() % 1000,
+            rand() % 1000, rand() % 10000, rand() % 100000, rand() % 1000000,
+            0, rand() % 2
+        };
+        const int sign = duration.negative ? -1 : 1;
+        iso8601_time expected = {
+            rand() % 4000 - 1000, rand() % 12 + 1, rand() % 28 + 1,
+            rand() % 24, rand() % 60, rand() % 60, rand() % 1000000
+        };
+
+        time = expected;
+        iso8601_add_years(&expected, sign * duration.years);
+        iso8601_add_months(&expected, sign * duration.months);
+        iso8601_add_days(&expected, sign * (duration.weeks * 7 +
+                                            duration.days));
+        iso8601_add_hours(&expected, sign * duration.hours);
+        iso8601_add_minutes(&expected, sign * duration.minutes);
+        iso8601_add_seconds(&expected, sign * duration.seconds);
+        iso8601_add_useconds(&expected, sign * duration.useconds);
+
+        assert(iso8601_add_duration(&time, &duration) == 0);
+        assert(memcmp(&time, &expected, sizeof(time)) == 0);
+    }
+
+    /* Invalid durations and overflow. */
+    time = (iso8601_time) { 2000, 1, 1 };
+    assert(iso8601_add_duration(&time, &(iso8601_duration) {
+        .useconds = 1000000 }) == EINVAL);
+    assert(iso8601_add_duration(&time, &(iso8601_duration) {
+        .nseconds = 1000 }) == EINVAL);
+    assert(iso8601_add_duration(NULL, &(iso8601_duration) {}) == EINVAL);
+    assert(iso8601_add_duration(&time, NULL) == EINVAL);
+    time.year = INT32_MAX;
+    assert(iso8601_add_duration(&time, &(iso8601_duration) {
+        .months = 12 }) == ERANGE);
+    assert(iso8601_add_duration(&time, &(iso8601_duration) {
+        .days = 365 }) == ERANGE);
+    assert(time.year == INT32_MAX);
+}
+
 int main(int argc, const char **argv)
 {
     for (size_t i = 0; tests[i].name; i++) {
         fprintf(stderr, "TEST: %s\n", tests[i].name);
         for (size_t j = 0; j < tests[i].count; j++) {
             iso8601_time time = tests[i].xform[j].before;
+            iso8601_duration duration;
             char before[128] = {};
             char answer[128] = {};
             char result[128] = {};
@@ -214,6 +318,14 @@ int main(int argc, const char **argv)
             fprintf(stderr, "result: %s\n\n", result);
 
             assert(memcmp(&time, &tests[i].xform[j].after, sizeof(time)) == 0);
+
+            time = tests[i].xform[j].before;
+            duration = as_duration(tests[i].name, tests[i].xform[j].increment);
+            assert(iso8601_add_duration(&time, &duration) == 0);
+            assert(memcmp(&time, &tests[i].xform[j].after, sizeof(time)) == 0);
         }
     }
+
+    test_duration();
+    return 0;
 }
@@ -0,0 +1,227 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/**
+ * Copyright: 2013 Red Hat, Inc.
+ * Author: Nathaniel McCallum <npmccallum@redhat.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iso8601.h"
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define N 100003
+#define LEN 40
+#define CALLERS 4
+#define M 4096
+
+static char strings[N][LEN];
+static const char *in[N];
+static size_t lens[N];
+static iso8601_time expected[N];
+static int estatus[N];
+static iso8601_time out[N];
+static int status[N];
+static char text[N][LEN];
+static size_t calls;
+static iso8601_time touts[CALLERS][M];
+static int tstatus[CALLERS][M];
+
+/* Run the workers one at a time, last first, so that they must steal. */
+static void
+backwards(void *ctx, size_t workers, void (*task)(void *arg, size_t worker),
+          void *arg)
+{
+    assert(ctx == &calls);
+    calls++;
+
+    for (size_t i = workers; i > 0; i--)
+        task(arg, i - 1);
+}
+
+/* Run only the first worker, which must then steal everything else. */
+static void
+first(void *ctx, size_t workers, void (*task)(void *arg, size_t worker),
+      void *arg)
+{
+    task(arg, 0);
+}
+
+static void
+check_parse(size_t threads, iso8601_executor executor)
+{
+    fprintf(stderr, "parse: %zu threads, executor %d\n", threads,
+            executor != NULL);
+
+    memset(out, 0, sizeof(out));
+    memset(status, 0xff, sizeof(status));
+    assert(iso8601_parse_batch_parallel(in, lens, N, out, status, threads,
+                                        executor, &calls) == EINVAL);
+    assert(memcmp(status, estatus, sizeof(status)) == 0);
+    for (size_t i = 0; i < N; i++) {
+        if (estatus[i] == 0)
+            assert(memcmp(&out[i], &expected[i], sizeof(*out)) == 0);
+    }
+}
+
+static void
+check_unparse(size_t threads, iso8601_executor executor)
+{
+    fprintf(stderr, "unparse: %zu threads, executor %d\n", threads,
+            executor != NULL);
+
+    memset(text, 0, sizeof(text));
+    assert(iso8601_unparse_batch_parallel(expected, N, ISO8601_FLAG_NONE, 4,
+                                          ISO8601_FORMAT_NORMAL,
+                                          ISO8601_TRUNCATE_NONE, LEN,
+                                          &text[0][0], status, threads,
+                                          executor, &calls) == EINVAL);
+    for (size_t i = 0; i < N; i++) {
+        char buf[LEN];
+
+        assert(status[i] == iso8601_unparse(&expected[i], ISO8601_FLAG_NONE, 4,
+                                            ISO8601_FORMAT_NORMAL,
+                                            ISO8601_TRUNCATE_NONE,
+                                            sizeof(buf), buf));
+        if (status[i] == 0)
+            assert(strcmp(text[i], buf) == 0);
+    }
+}
+
+/* One of several callers which share the pool, or find it busy. */
+static void *
+caller(void *arg)
+{
+    const size_t c = (iso8601_time (*)[M]) arg - touts;
+
+    for (int r = 0; r < 20; r++) {
+        memset(touts[c], 0, sizeof(touts[c]));
+        assert(iso8601_parse_batch_parallel(in, lens, M, touts[c], tstatus[c],
+                                            3, NULL, NULL) == EINVAL);
+        assert(memcmp(tstatus[c], estatus, sizeof(tstatus[c])) == 0);
+        for (size_t i = 0; i < M; i++) {
+            if (estatus[i] == 0)
+                assert(memcmp(&touts[c][i], &expected[i],
+                              sizeof(expected[i])) == 0);
+        }
+    }
+
+    return NULL;
+}
+
+static void
+check_callers(void)
+{
+    pthread_t threads[CALLERS];
+
+    fprintf(stderr, "parse: %d callers at once\n", CALLERS);
+    for (size_t i = 0; i < CALLERS; i++)
+        assert(pthread_create(&threads[i], NULL, caller, &touts[i]) == 0);
+    for (size_t i = 0; i < CALLERS; i++)
+        assert(pthread_join(threads[i], NULL) == 0);
+}
+
+/* A child has none of the pool's threads, but must still finish batches. */
+static void
+check_fork(void)
+{
+    int wstatus;
+    pid_t pid;
+
+    /* ThreadSanitizer can't start threads after a multithreaded fork. */
+#if defined(__SANITIZE_THREAD__)
+    return;
+#endif
+
+    fprintf(stderr, "parse: after fork\n");
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        check_parse(4, NULL);
+        check_unparse(3, NULL);
+        _exit(0);
+    }
+
+    assert(waitpid(pid, &wstatus, 0) == pid);
+    assert(WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0);
+}
+
+int
+main(int argc, const char **argv)
+{
+    /* Every 97th string is invalid. */
+    for (size_t i = 0; i < N; i++) {
+        const int day = i % 28 + 1;
+
+        if (i % 97 == 0)
+            snprintf(strings[i], LEN, "2024-02-%02dT25:00Z", day);
+        else
+            snprintf(strings[i], LEN,
+                     "%04zu-%02zu-%02dT%02zu:%02zu:%02zu.%zuZ",
+                     1900 + i % 200, i % 12 + 1, day, i % 24, i % 60,
+                     i / 60 % 60, i % 1000);
+
+        in[i] = strings[i];
+        lens[i] = strlen(strings[i]);
+        estatus[i] = iso8601_parse_n(in[i], lens[i], NULL, &expected[i]);
+        assert((estatus[i] == 0) == (i % 97 != 0));
+    }
+
+    /* Leave a year that unparse can't write in four digits. */
+    expected[0] = (iso8601_time) { 12345, 1, 1 };
+
+    check_parse(1, NULL);
+    check_parse(4, NULL);
+    check_parse(0, NULL);
+    check_parse(1000, NULL);
+    check_parse(7, backwards);
+    check_parse(7, first);
+    assert(calls == 1);
+    check_callers();
+
+    check_unparse(1, NULL);
+    check_unparse(3, NULL);
+    check_unparse(0, NULL);
+    check_unparse(5, backwards);
+    check_unparse(5, first);
+    assert(calls == 2);
+    check_fork();
+
+    /* The strings may also be NUL-terminated. */
+    assert(iso8601_parse_batch_parallel(&in[1], NULL, 96, out, NULL, 2, NULL,
+                                        NULL) == 0);
+    assert(memcmp(out, &expected[1], 96 * sizeof(*out)) == 0);
+
+    /* Too short a buffer fails each element. */
+    assert(iso8601_unparse_batch_parallel(&expected[1], 96, ISO8601_FLAG_NONE,
+                                          4, ISO8601_FORMAT_NORMAL,
+                                          ISO8601_TRUNCATE_NONE, 8,
+                                          &text[0][0], status, 2, NULL,
+                                          NULL) == EINVAL);
+    for (size_t i = 0; i < 96; i++)
+        assert(status[i] == E2BIG);
+
+    assert(iso8601_parse_batch_parallel(NULL, NULL, 0, NULL, NULL, 0, NULL,
+                                        NULL) == 0);
+    assert(iso8601_parse_batch_parallel(NULL, NULL, 1, out, NULL, 0, NULL,
+                                        NULL) == EINVAL);
+    assert(iso8601_parse_batch_parallel(&in[1], &lens[1], 1, out, NULL, 0,
+                                        backwards, &calls) == EINVAL);
+    assert(calls == 2);
+    return 0;
+}
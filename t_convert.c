@@ -0,0 +1,208 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/**
+ * Copyright: 2013 Red Hat, Inc.
+ * Author: Nathaniel McCallum <npmccallum@redhat.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Runs the iso8601-convert tool given as the first argument. */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* One timestamp with a zone, one with CRLF and one local ordinal date. */
+#define INPUT \
+    "2024-02-29T12:30:15.5+01:00\n" \
+    "1989-02-12T13:14:15Z\r\n" \
+    "2024-001T00:00\n"
+
+static const struct {
+    const char *args[8];
+    const char *input;
+    const char *output;
+    int status;
+} tests[] = {
+    { {}, INPUT,
+      "2024-02-29T12:30:15.500000+01:00\n"
+      "1989-02-12T13:14:15Z\n"
+      "2024-01-01T00:00:00\n" },
+    { { "-f", "week" }, INPUT,
+      "2024-W09-4T12:30:15.500000+01:00\n"
+      "1989-W06-7T13:14:15Z\n"
+      "2024-W01-1T00:00:00\n" },
+    { { "-f", "ordinal" }, INPUT,
+      "2024-060T12:30:15.500000+01:00\n"
+      "1989-043T13:14:15Z\n"
+      "2024-001T00:00:00\n" },
+    { { "-b" }, INPUT,
+      "20240229T123015.500000+01\n"
+      "19890212T131415Z\n"
+      "20240101T000000\n" },
+    { { "-b", "-f", "week", "-t", "week" }, INPUT,
+      "2024W09\n"
+      "1989W06\n"
+      "2024W01\n" },
+    { { "-b", "-f", "ordinal", "-t", "hour" }, INPUT,
+      "2024060T12+01\n"
+      "1989043T13Z\n"
+      "2024001T00\n" },
+    { { "-t", "minute" }, INPUT,
+      "2024-02-29T12:30+01:00\n"
+      "1989-02-12T13:14Z\n"
+      "2024-01-01T00:00\n" },
+    { { "-t", "day" }, INPUT,
+      "2024-02-29\n"
+      "1989-02-12\n"
+      "2024-01-01\n" },
+    { { "-p", "milli", "-y", "6" }, INPUT,
+      "002024-02-29T12:30:15.500+01:00\n"
+      "001989-02-12T13:14:15.000Z\n"
+      "002024-01-01T00:00:00.000\n" },
+    { { "-u", "-z", "60" }, INPUT,
+      "2024-02-29T11:30:15.500000Z\n"
+      "1989-02-12T13:14:15Z\n"
+      "2023-12-31T23:00:00Z\n" },
+    { { "-e", "s", "-z", "0" }, INPUT,
+      "1709206215\n"
+      "603292455\n"
+      "1704067200\n" },
+    { { "-e", "ms", "-z", "-300" }, INPUT,
+      "1709206215500\n"
+      "603292455000\n"
+      "1704085200000\n" },
+    { { "-e", "us", "-z", "90" }, INPUT,
+      "1709206215500000\n"
+      "603292455000000\n"
+      "1704061800000000\n" },
+    { { "-e", "ns", "-z", "90" }, INPUT,
+      "1709206215500000000\n"
+      "603292455000000000\n"
+      "1704061800000000000\n" },
+
+    /* Without -z, local input can't be placed in UTC or on the epoch. */
+    { { "-u" }, INPUT,
+      "2024-02-29T11:30:15.500000Z\n"
+      "1989-02-12T13:14:15Z\n"
+      "\n", 1 },
+    { { "-e", "s" }, INPUT,
+      "1709206215\n"
+      "603292455\n"
+      "\n", 1 },
+
+    /* Every line gives one line, even if it is invalid or empty. */
+    { {}, "2024-02-30\nnot a time\n\n2024-02-29T24:00Z\r\n1989",
+      "\n"
+      "\n"
+      "\n"
+      "2024-02-29T24:00:00Z\n"
+      "1989-01-01T00:00:00\n", 1 },
+    { {}, "", "" },
+
+    { { "-f", "julian" }, INPUT, "", 2 },
+    { { "-y", "10" }, INPUT, "", 2 },
+};
+
+/*
+ * Run the tool quietly on input, from a file or through a pipe on standard
+ * input, and check its output and exit status.
+ */
+static void
+run(const char *tool, size_t i, bool piped)
+{
+    char path[] = "/tmp/t_convert.XXXXXX";
+    const char *argv[16] = { tool, "-q" };
+    size_t argc = 2;
+    char out[4096];
+    size_t used = 0;
+    int inp[2] = { -1, -1 };
+    int outp[2];
+    int wstatus;
+    pid_t pid;
+    ssize_t ret;
+    int fd;
+
+    fprintf(stderr, "convert: test %zu, %s\n", i, piped ? "pipe" : "file");
+
+    for (size_t j = 0; tests[i].args[j] != NULL; j++)
+        argv[argc++] = tests[i].args[j];
+
+    if (piped) {
+        assert(pipe(inp) == 0);
+    } else {
+        fd = mkstemp(path);
+        assert(fd >= 0);
+        assert(write(fd, tests[i].input, strlen(tests[i].input)) ==
+               (ssize_t) strlen(tests[i].input));
+        assert(close(fd) == 0);
+        argv[argc++] = path;
+    }
+
+    assert(pipe(outp) == 0);
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        if (piped) {
+            dup2(inp[0], STDIN_FILENO);
+            close(inp[0]);
+            close(inp[1]);
+        }
+        dup2(outp[1], STDOUT_FILENO);
+        close(outp[0]);
+        close(outp[1]);
+        execv(tool, (char *const *) argv);
+        _exit(127);
+    }
+
+    assert(close(outp[1]) == 0);
+    if (piped) {
+        assert(close(inp[0]) == 0);
+        assert(write(inp[1], tests[i].input, strlen(tests[i].input)) ==
+               (ssize_t) strlen(tests[i].input));
+        assert(close(inp[1]) == 0);
+    }
+
+    while ((ret = read(outp[0], &out[used], sizeof(out) - 1 - used)) > 0)
+        used += ret;
+    assert(ret == 0);
+    assert(close(outp[0]) == 0);
+    out[used] = '\0';
+
+    assert(waitpid(pid, &wstatus, 0) == pid);
+    if (!piped)
+        assert(unlink(path) == 0);
+
+    fprintf(stderr, "answer: %s", tests[i].output);
+    fprintf(stderr, "result: %s", out);
+    assert(WIFEXITED(wstatus));
+    assert(WEXITSTATUS(wstatus) == tests[i].status);
+    assert(strcmp(out, tests[i].output) == 0);
+}
+
+int
+main(int argc, const char **argv)
+{
+    assert(argc == 2);
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(*tests); i++) {
+        run(argv[1], i, false);
+        run(argv[1], i, true);
+    }
+
+    return 0;
+}
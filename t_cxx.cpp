@@ -0,0 +1,139 @@
+/* vim: set tabstop=8 shiftwidth=4 softtabstop=4 expandtab smarttab colorcolumn=80: */
+/**
+ * Copyright: 2013 Red Hat, Inc.
+ * Author: Nathaniel McCallum <npmccallum@redhat.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "iso8601.hpp"
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+using namespace iso8601::literals;
+
+/* Everything here is checked by the compiler. */
+constexpr iso8601_time cutover = "2024-07-01T00:00Z"_iso8601;
+static_assert(cutover.year == 2024 && cutover.month == 7, "");
+static_assert(iso8601::epoch(cutover) == 1719792000, "");
+static_assert(iso8601::epoch(cutover, ISO8601_UNIT_MILLI) ==
+              1719792000000, "");
+
+constexpr iso8601_time week = "2009-W53-7T12:30:15.25+01:00"_iso8601;
+static_assert(week.year == 2010 && week.month == 1 && week.day == 3, "");
+static_assert(week.hour == 12 && week.minute == 30 && week.second == 15, "");
+static_assert(week.usecond == 250000 && week.tzminutes == 60, "");
+
+constexpr iso8601_time ordinal = iso8601::parse("2024366");
+static_assert(ordinal.month == 12 && ordinal.day == 31, "");
+static_assert(ordinal.localtime, "");
+static_assert(iso8601::epoch(ordinal, ISO8601_UNIT_SECOND, -300) ==
+              1735621200, "");
+
+static_assert(iso8601::compare("2024-01-01T24:00Z"_iso8601,
+                               "2024-01-02T01:00+01:00"_iso8601) == 0, "");
+static_assert(iso8601::compare("2024-01-01T00:00:00.000000001Z"_iso8601,
+                               "2024-01-01T00:00Z"_iso8601) > 0, "");
+static_assert(iso8601::compare("2024-01-01T12:00"_iso8601,
+                               "2024-01-01T12:01"_iso8601) < 0, "");
+
+static_assert(iso8601::epoch("1969-12-31T23:59:59.5Z"_iso8601,
+                             ISO8601_UNIT_MILLI) == -500, "");
+static_assert(iso8601::epoch("-999999999-01-01T00Z"_iso8601) ==
+              -31557014135596800, "");
+
+static const char *const DATA[] = {
+    "1989", "1989-02", "1989-02-12", "19890212", "1989-043", "1989043",
+    "1989-W06", "1989W06", "1989-W06-7", "1989W067", "2008-W01-1",
+    "1989-02-12T13", "1989-02-12T13:14", "1989-02-12T13:14:15",
+    "1989-02-12T13:14:15.123456789123", "1989-02-12T13.5",
+    "1989-02-12T13:14.25", "19890212T131415Z", "1989-02-12T13:14:15-05",
+    "1989-02-12T13:14:15+05:30", "1989-02-12T24:00", "1989-02-12T24:00:00.0",
+    "2016-12-31T23:59:60Z", "+002016-12-31T00", "-0001-01-01", "+12345-W01",
+    "1989-02-12T13:14:15-", "1989-02-29", "1989-13", "1989-W54",
+    "1989-02-12T24:01", "1989-02-12T24:00:00.5", "1989-02-12T13:14:15+25",
+    "198", "1989-02-12T13:14:15.123,", "1989-366", "",
+};
+
+static void
+test_parse(const char *str)
+{
+    iso8601_time expected = {};
+    iso8601_time time = {};
+    bool valid = true;
+
+    fprintf(stderr, "parse: %s\n", str);
+
+    try {
+        time = iso8601::parse(str, strlen(str));
+    } catch (const std::invalid_argument &) {
+        valid = false;
+    }
+
+    assert(valid == (iso8601_parse(str, &expected) == 0));
+    if (!valid)
+        return;
+
+    assert(time.year == expected.year);
+    assert(time.month == expected.month);
+    assert(time.day == expected.day);
+    assert(time.hour == expected.hour);
+    assert(time.minute == expected.minute);
+    assert(time.second == expected.second);
+    assert(time.usecond == expected.usecond);
+    assert(time.nsecond == expected.nsecond);
+    assert(time.localtime == expected.localtime);
+    assert(time.tzminutes == expected.tzminutes);
+    assert(iso8601::compare(time, expected) == 0);
+
+    for (int unit = ISO8601_UNIT_SECOND; unit <= ISO8601_UNIT_NANO; unit++) {
+        const int16_t zone = -300;
+        int64_t epoch = 0;
+        int err;
+
+        err = iso8601_parse_epoch(str, SIZE_MAX, NULL, (iso8601_unit) unit,
+                                  &zone, &epoch);
+        if (err == 0) {
+            assert(iso8601::epoch(time, (iso8601_unit) unit, zone) == epoch);
+            continue;
+        }
+
+        assert(err == ERANGE);
+        try {
+            iso8601::epoch(time, (iso8601_unit) unit, zone);
+            assert(false);
+        } catch (const std::range_error &) {
+        }
+    }
+}
+
+int
+main(int argc, const char **argv)
+{
+    for (const char *str : DATA)
+        test_parse(str);
+
+    /* At run time, local times are compared by the library. */
+    assert(iso8601::compare("2024-01-01T00:00"_iso8601, cutover) < 0);
+
+    try {
+        iso8601::epoch("2024-01-01"_iso8601);
+        assert(false);
+    } catch (const std::invalid_argument &) {
+    }
+
+    return 0;
+}
@@ -99,6 +99,40 @@ int main(int argc, const char **argv)
     assert(length_month_days(2012, 13) == 0);
     assert(length_year_weeks(2008) == 52);
     assert(length_year_weeks(2009) == 53);
+    assert(length_year_weeks(2015) == 53);
+    assert(length_year_weeks(-1) == 52);
+    assert(length_year_weeks(999999999) >= 52);
+
+    /* Test days_from_civil(). */
+    assert(days_from_civil(1970, 1, 1) == 0);
+    assert(days_from_civil(1970, 1, 2) == 1);
+    assert(days_from_civil(1969, 12, 31) == -1);
+    assert(days_from_civil(2000, 3, 1) == 11017);
+    assert(days_from_civil(2038, 1, 19) == 24855);
+    assert(days_from_civil(0, 3, 1) == -719468);
+    assert(days_from_civil(-1, 12, 31) == -719529);
+    for (int32_t y = -1000, d = days_from_civil(-1000, 1, 1); y < 3000; y++) {
+        assert(days_from_civil(y, 1, 1) == d);
+        for (uint8_t m = 1; m <= 12; m++) {
+            for (uint8_t dd = 1; dd <= length_month_days(y, m); dd++) {
+                assert(civil_from_days(d, &year, &month, &day));
+                assert(year == y && month == m && day == dd);
+                assert(days_from_civil(y, m, dd) == d++);
+            }
+        }
+    }
+
+    /* Test civil_from_days(). */
+    assert(civil_from_days(days_from_civil(INT32_MAX, 12, 31),
+                           &year, &month, &day));
+    assert(year == INT32_MAX && month == 12 && day == 31);
+    assert(!civil_from_days(days_from_civil(INT32_MAX, 12, 31) + 1,
+                            &year, &month, &day));
+    assert(civil_from_days(days_from_civil(INT32_MIN, 1, 1),
+                           &year, &month, &day));
+    assert(year == INT32_MIN && month == 1 && day == 1);
+    assert(!civil_from_days(days_from_civil(INT32_MIN, 1, 1) - 1,
+                            &year, &month, &day));
 
     /* Test ordinal_*_date(). */
     for (size_t i = 0; i < ARRAY_LENGTH(ordinals); i++) {
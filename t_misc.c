@@ -17,6 +17,7 @@
  */
 
 #include "iso8601.h"
+#include <errno.h>
 #include <stdio.h>
 #include <assert.h>
 
@@ -61,6 +62,12 @@ int main(int argc, const char **argv)
                            &(iso8601_time) { 2000, 1, 1, 0, 1 }) < 0);
     assert(iso8601_compare(&(iso8601_time) { 2000, 1, 1, 0, 1 },
                            &(iso8601_time) { 2000, 1, 1, 0, 0 }) > 0);
+    assert(iso8601_compare(&(iso8601_time) { 2000, 1, 1, 0, 0, 0, 1 },
+                           &(iso8601_time) { 2000, 1, 1, 0, 0, 0, 0,
+                                             false, 0, 999 }) > 0);
+    assert(iso8601_compare(&(iso8601_time) { 2000, 1, 1, 0, 0, 0, 1,
+                                             false, 0, 1 },
+                           &(iso8601_time) { 2000, 1, 1, 0, 0, 0, 1 }) > 0);
 
 
     /*
@@ -126,6 +133,35 @@ int main(int argc, const char **argv)
     assert(iso8601_parse("-0100-01-01T00:00:00Z", &tb) == 0);
     assert(iso8601_compare(&ta, &tb) > 0);
     assert(iso8601_compare(&tb, &ta) < 0);
+    /* Check normalization at parse time. */
+    assert(iso8601_parse_normalized("2016-12-31T24:00+01:00", SIZE_MAX, NULL,
+                                    &ta) == 0);
+    assert(ta.year == 2016 && ta.month == 12 && ta.day == 31);
+    assert(ta.hour == 23 && ta.minute == 0 && !ta.localtime);
+    assert(ta.tzminutes == 0);
+    assert(iso8601_parse("2017-01-01T00:00+01:00", &tb) == 0);
+    assert(iso8601_compare(&ta, &tb) == 0);
+    assert(iso8601_parse_normalized("2016-12-31T23:59:60-01:30", SIZE_MAX,
+                                    NULL, &ta) == 0);
+    assert(ta.year == 2017 && ta.month == 1 && ta.day == 1);
+    assert(ta.hour == 1 && ta.minute == 29 && ta.second == 60);
+    assert(iso8601_parse_normalized("1999-12-31T24:00", SIZE_MAX, NULL,
+                                    &ta) == 0);
+    assert(ta.year == 2000 && ta.month == 1 && ta.day == 1);
+    assert(ta.hour == 0 && ta.localtime);
+    assert(iso8601_parse_normalized("1999-12-31T25:00", SIZE_MAX, NULL,
+                                    &ta) == EINVAL);
+
+    /* Normalized times compare without being normalized again. */
+    assert(iso8601_parse_normalized("2000-01-01T00:00:00.5Z", SIZE_MAX, NULL,
+                                    &ta) == 0);
+    assert(iso8601_parse_normalized("2000-01-01T01:00+01:00", SIZE_MAX, NULL,
+                                    &tb) == 0);
+    assert(iso8601_compare(&ta, &tb) > 0);
+    assert(iso8601_compare(&tb, &ta) < 0);
+    tb.usecond = 500000;
+    assert(iso8601_compare(&ta, &tb) == 0);
+
 #if SIZEOF_TIME_T > 4
     /* Fails when time_t is too small to represent the dates. */
     assert(iso8601_parse("9999-01-01T00:00:01", &ta) == 0);
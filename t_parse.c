@@ -159,6 +159,9 @@ static const struct test_data TEST_DATA[] = {
     {"20000000000000000000000000000000000000000000000000000000000000000000000"},
     {"W2000-01-01"},
     {"2000--W"},
+    {"2000T", 0, true},
+    {"2000-01-01T", 0, true},
+    {"2000-01-01.5"},
 
 
     /* Test leap year. */
@@ -168,6 +171,8 @@ static const struct test_data TEST_DATA[] = {
     {},
 };
 
+static iso8601_parser parser;
+
 static bool
 is_ext_year(const char *iso8601)
 {
@@ -183,8 +188,13 @@ is_ext_year(const char *iso8601)
 static void
 test_one(const char *iso8601, time_t expected)
 {
+    const size_t len = strlen(iso8601);
+    iso8601_time ntime;
     iso8601_time time;
+    const char *end;
+    char buf[1024];
     time_t tmp = 0;
+    int64_t epoch;
     int err;
 
     fprintf(stderr, "string: %s\n", iso8601);
@@ -194,12 +204,75 @@ test_one(const char *iso8601, time_t expected)
     fprintf(stderr, "return: %d\n", err);
     assert((err == 0) == (expected != 0));
     assert(err == 0 || err == EINVAL);
+
+    /* The adaptive parser must agree, whether it learned the layout or not. */
+    for (int i = 0; i < 2; i++) {
+        memset(&ntime, 0, sizeof(ntime));
+        assert(iso8601_parser_parse(&parser, iso8601, len, NULL, &ntime) == err);
+        assert(err != 0 || memcmp(&time, &ntime, sizeof(time)) == 0);
+    }
+
+    /* Validation must accept exactly what the parser accepts. */
+    assert(iso8601_validate(iso8601, len) == err);
+    assert(iso8601_validate(iso8601, SIZE_MAX) == err);
+
     if (expected == 0)
         return;
 
     iso8601_to_time_t(&time, &tmp);
     fprintf(stderr, "result: %ld\n\n", tmp);
     assert(tmp == expected);
+
+    /* The epoch parser must agree without the C library. */
+    assert(iso8601_parse_epoch(iso8601, len, NULL, ISO8601_UNIT_SECOND,
+                               &(int16_t) { -5 * 60 }, &epoch) == 0);
+    assert(epoch == expected);
+
+    /* The length-bounded parser must agree when consuming everything. */
+    assert(iso8601_parse_n(iso8601, len, NULL, &ntime) == 0);
+    assert(memcmp(&time, &ntime, sizeof(time)) == 0);
+
+    /* The normalized time must be the same instant, in UTC if zoned. */
+    assert(iso8601_parse_normalized(iso8601, len, NULL, &ntime) == 0);
+    assert(ntime.hour < 24);
+    assert(ntime.localtime == time.localtime);
+    assert(ntime.localtime || ntime.tzminutes == 0);
+    assert(iso8601_compare(&time, &ntime) == 0);
+    assert(iso8601_compare(&ntime, &time) == 0);
+
+    /* Trailing bytes must be left unconsumed. */
+    snprintf(buf, sizeof(buf), "%s,X", iso8601);
+    assert(iso8601_parse_n(buf, len + 2, NULL, &ntime) == EINVAL);
+
+    /* The push parser must agree wherever the input is split. */
+    for (size_t i = 0; i <= len; i++) {
+        iso8601_push_parser push = {};
+        size_t used;
+
+        memset(&ntime, 0, sizeof(ntime));
+        assert(iso8601_push_parse(&push, buf, i, &used, &ntime) == EAGAIN);
+        assert(used == i);
+        assert(iso8601_push_parse(&push, &buf[i], len + 2 - i, &used,
+                                  &ntime) == 0);
+        assert(used == len - i + 1);
+        assert(memcmp(&time, &ntime, sizeof(time)) == 0);
+
+        memset(&ntime, 0, sizeof(ntime));
+        assert(iso8601_push_parse(&push, buf, i, &used, &ntime) == EAGAIN);
+        assert(iso8601_push_parse(&push, &buf[i], len - i, &used,
+                                  &ntime) == EAGAIN);
+        assert(iso8601_push_finish(&push, &ntime) == 0);
+        assert(memcmp(&time, &ntime, sizeof(time)) == 0);
+    }
+    assert(iso8601_validate(buf, len + 2) == EINVAL);
+    assert(iso8601_parse_n(buf, len + 2, &end, &ntime) == 0);
+    assert(end == &buf[len]);
+    assert(memcmp(&time, &ntime, sizeof(time)) == 0);
+
+    memset(&ntime, 0, sizeof(ntime));
+    assert(iso8601_parser_parse(&parser, buf, len + 2, &end, &ntime) == 0);
+    assert(end == &buf[len]);
+    assert(memcmp(&time, &ntime, sizeof(time)) == 0);
 }
 
 static void
@@ -267,6 +340,1071 @@ test(const struct test_data *data)
     }
 }
 
+static const struct {
+    const char *string;
+    size_t len;
+    size_t consumed;
+} PREFIX_DATA[] = {
+    { "2010-02-14T13:14:23Z rest",  25, 20 },
+    { "2010-02-14T13:14:23.5Z\",",  24, 22 },
+    { "20100214T131423+0130;",      21, 20 },
+    { "2010-02-14 13:14:23",        19, 10 },
+    { "2010-02-14T1",               12, 10 },
+    { "2010-02-14T13:14:23.",       20, 19 },
+    { "2010-02-14T13:14:23+1",      21, 19 },
+    { "2010-02-14T13:14:23Z",       13, 13 },
+    { "2010-02-14T13:14:23Z",        7,  7 },
+    { "2010-02-14T13:14:23Z",        6,  4 },
+    { "2010-W06-7T13:14:23Z",       10, 10 },
+    { "2010-02-14\0T13:14:23Z",     21, 10 },
+    {}
+};
+
+static void
+test_prefix(void)
+{
+    for (int i = 0; PREFIX_DATA[i].string != NULL; i++) {
+        const char *str = PREFIX_DATA[i].string;
+        iso8601_time time;
+        const char *end;
+        char buf[64];
+
+        fprintf(stderr, "prefix: %.*s\n", (int) PREFIX_DATA[i].len, str);
+
+        /* Copy without a NUL terminator so that overreads are caught. */
+        memset(buf, '9', sizeof(buf));
+        memcpy(buf, str, PREFIX_DATA[i].len);
+        assert(iso8601_parse_n(buf, PREFIX_DATA[i].len, &end, &time) == 0);
+        assert(end == &buf[PREFIX_DATA[i].consumed]);
+    }
+
+    assert(iso8601_parse_n(NULL, 0, NULL, NULL) == EINVAL);
+    assert(iso8601_parse_n("", 0, NULL, NULL) == EINVAL);
+    assert(iso8601_parse_n("2010", 3, NULL, NULL) == EINVAL);
+    assert(iso8601_parse_n("2010-13-01", 10, NULL, NULL) == EINVAL);
+}
+
+/* Decimals are exact to the nanosecond, whichever component they follow. */
+static const struct {
+    const char *string;
+    uint8_t minute;
+    uint8_t second;
+    uint32_t usecond;
+    uint16_t nsecond;
+} DECIMAL_DATA[] = {
+    { "2010-02-14T13:14:23.123456789Z", 14, 23, 123456, 789 },
+    { "2010-02-14T13:14:23.000000001Z", 14, 23, 0, 1 },
+    { "2010-02-14T13:14:23.1234567891Z", 14, 23, 123456, 789 },
+    { "20100214T131423.999999999",       14, 23, 999999, 999 },
+    { "2010-02-14T13:14:23.5",          14, 23, 500000, 0 },
+    { "2010-02-14T13:14.5Z",            14, 30, 0, 0 },
+    { "2010-02-14T13:30.123456789Z",    30, 7, 407407, 340 },
+    { "2010-02-14T13.51Z",              30, 36, 0, 0 },
+    { "2010-02-14T13.123456789Z",       7, 24, 444440, 400 },
+    { "2010-02-14T13.999999999Z",       59, 59, 999996, 400 },
+    {}
+};
+
+static void
+test_decimal(void)
+{
+    for (int i = 0; DECIMAL_DATA[i].string != NULL; i++) {
+        iso8601_time time;
+
+        fprintf(stderr, "decimal: %s\n", DECIMAL_DATA[i].string);
+        assert(iso8601_parse(DECIMAL_DATA[i].string, &time) == 0);
+        assert(time.hour == 13);
+        assert(time.minute == DECIMAL_DATA[i].minute);
+        assert(time.second == DECIMAL_DATA[i].second);
+        assert(time.usecond == DECIMAL_DATA[i].usecond);
+        assert(time.nsecond == DECIMAL_DATA[i].nsecond);
+    }
+}
+
+/* Pairs of canonical extended strings and their basic equivalents. */
+static const struct {
+    const char *extended;
+    const char *basic;
+} FAST_DATA[] = {
+    { "2010-02-14T13:14:23Z",            "20100214T131423Z" },
+    { "2010-02-14T13:14:23",             "20100214T131423" },
+    { "2010-02-14T13:14:23.123456Z",     "20100214T131423.123456Z" },
+    { "2010-02-14T13:14:23.1+01:30",     "20100214T131423.1+0130" },
+    { "2010-02-14T13:14:23.123456789-05", "20100214T131423.123456789-05" },
+    { "2000-02-29T00:00:00Z",            "20000229T000000Z" },
+    { "2000-12-31T23:59:60Z",            "20001231T235960Z" },
+    { "1999-12-31T24:00:00Z",            "19991231T240000Z" },
+    { "0000-01-01T00:00:00Z",            "00000101T000000Z" },
+    { "2010-02-14T13:14:23Z!",           NULL },
+    { "2010-02-14T13:14:23.Z",           NULL },
+    { "2010-02-30T13:14:23Z",            NULL },
+    { "2010-13-14T13:14:23Z",            NULL },
+    { "2010-00-14T13:14:23Z",            NULL },
+    { "2010-02-14T25:14:23Z",            NULL },
+    { "2010-02-14T23:60:23Z",            NULL },
+    { "2010-02-14T23:59:61Z",            NULL },
+    { "2010-02-14T24:00:01Z",            NULL },
+    { "2010-02-14T13:14:23+25:00",       NULL },
+    { "2010-02-14T13:14:2",              NULL },
+    { "2010-02-14T13:14:/3Z",            NULL },
+    { "2010-02-14T13:1:23Z",             NULL },
+    { "2010/02/14T13:14:23Z",            NULL },
+    {}
+};
+
+static void
+test_fast(void)
+{
+    for (int i = 0; FAST_DATA[i].extended != NULL; i++) {
+        iso8601_time ext = {};
+        iso8601_time bas = {};
+
+        fprintf(stderr, "fast: %s\n", FAST_DATA[i].extended);
+
+        if (FAST_DATA[i].basic == NULL) {
+            assert(iso8601_parse(FAST_DATA[i].extended, &ext) == EINVAL);
+            continue;
+        }
+
+        assert(iso8601_parse(FAST_DATA[i].extended, &ext) == 0);
+        assert(iso8601_parse(FAST_DATA[i].basic, &bas) == 0);
+        assert(memcmp(&ext, &bas, sizeof(ext)) == 0);
+    }
+}
+
+static void
+test_batch(void)
+{
+    const size_t n = sizeof(TEST_DATA) / sizeof(*TEST_DATA) - 1;
+    const char *in[n];
+    iso8601_time out[n];
+    int status[n];
+    size_t lens[n];
+
+    for (size_t i = 0; i < n; i++) {
+        in[i] = TEST_DATA[i].string;
+        lens[i] = strlen(in[i]);
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        bool failed = false;
+
+        memset(out, 0, sizeof(out));
+        memset(status, 0xff, sizeof(status));
+        assert(iso8601_parse_batch(in, pass ? lens : NULL, n,
+                                   out, status) == EINVAL);
+
+        for (size_t i = 0; i < n; i++) {
+            iso8601_time time = {};
+
+            assert(status[i] == iso8601_parse(in[i], &time));
+            assert(memcmp(&time, &out[i], sizeof(time)) == 0);
+            failed |= status[i] != 0;
+        }
+
+        assert(failed);
+    }
+
+    /* Only valid elements succeed as a whole. */
+    assert(iso8601_parse_batch(in, lens, 2, out, NULL) == 0);
+    assert(iso8601_parse_batch(in, NULL, 0, NULL, NULL) == 0);
+    assert(iso8601_parse_batch(NULL, NULL, 1, out, NULL) == EINVAL);
+}
+
+static void
+test_column(void)
+{
+    const size_t n = sizeof(TEST_DATA) / sizeof(*TEST_DATA) - 1;
+    int32_t offsets32[n + 1];
+    int64_t offsets64[n + 1];
+    int32_t year[n];
+    uint8_t month[n];
+    uint8_t day[n];
+    uint8_t hour[n];
+    uint8_t minute[n];
+    uint8_t second[n];
+    uint32_t usecond[n];
+    bool localtime[n];
+    int16_t tzminutes[n];
+    uint16_t nsecond[n];
+    int status[n];
+    size_t size = 0;
+    char *data;
+
+    const iso8601_columns out = {
+        year, month, day, hour, minute, second, usecond, localtime, tzminutes,
+        nsecond
+    };
+
+    for (size_t i = 0; i < n; i++)
+        size += strlen(TEST_DATA[i].string);
+
+    /* No terminators or padding, so that overreads are caught. */
+    data = malloc(size);
+    assert(data);
+
+    offsets32[0] = offsets64[0] = 0;
+    for (size_t i = 0; i < n; i++) {
+        const size_t len = strlen(TEST_DATA[i].string);
+        memcpy(&data[offsets64[i]], TEST_DATA[i].string, len);
+        offsets32[i + 1] = offsets64[i + 1] = offsets64[i] + len;
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        memset(status, 0xff, sizeof(status));
+        memset(year, 0, sizeof(year));
+
+        if (pass == 0)
+            assert(iso8601_parse_column32(data, offsets32, n,
+                                          &out, status) == EINVAL);
+        else
+            assert(iso8601_parse_column64(data, offsets64, n,
+                                          &out, status) == EINVAL);
+
+        for (size_t i = 0; i < n; i++) {
+            iso8601_time time = {};
+
+            assert(status[i] == iso8601_parse(TEST_DATA[i].string, &time));
+            if (status[i] != 0) {
+                assert(year[i] == 0);
+                continue;
+            }
+
+            assert(year[i] == time.year);
+            assert(month[i] == time.month);
+            assert(day[i] == time.day);
+            assert(hour[i] == time.hour);
+            assert(minute[i] == time.minute);
+            assert(second[i] == time.second);
+            assert(usecond[i] == time.usecond);
+            assert(localtime[i] == time.localtime);
+            assert(tzminutes[i] == time.tzminutes);
+            assert(nsecond[i] == time.nsecond);
+        }
+    }
+
+    /* Columns may be omitted. */
+    assert(iso8601_parse_column32(data, offsets32, 2,
+                                  &(iso8601_columns) { .year = year },
+                                  NULL) == 0);
+
+    /* Offsets must be monotonic. */
+    offsets64[1] = -1;
+    assert(iso8601_parse_column64(data, offsets64, 1, &out, status) == EINVAL);
+    assert(status[0] == EINVAL);
+
+    free(data);
+}
+
+static void
+test_layout(void)
+{
+    static const iso8601_layout canonical = {
+        ISO8601_FORMAT_NORMAL, ISO8601_TRUNCATE_SECOND, ISO8601_FLAG_NONE,
+        3, ISO8601_ZONE_UTC
+    };
+    static const iso8601_time times[] = {
+        { 2000, 3, 3, 3, 3, 3, 123456, false, 90 },
+        { 2000, 3, 3, 3, 3, 3, 0, false, -60 },
+        { 2000, 12, 31, 23, 59, 59, 0, false, 0 },
+        { 2000, 1, 1, 24, 0, 0, 0, true, 0 },
+    };
+    const char *end = NULL;
+    iso8601_time time;
+
+    for (size_t i = 0; i < sizeof(times) / sizeof(*times); i++) {
+        for (int f = ISO8601_FORMAT_NORMAL; f <= ISO8601_FORMAT_ORDINAL; f++) {
+            for (int t = 0; t <= ISO8601_TRUNCATE_SECOND; t++) {
+                for (uint32_t flags = 0; flags <= ISO8601_FLAG_BASIC; flags++) {
+                    iso8601_layout layout = { f, t, flags };
+                    iso8601_time expected;
+                    char buf[128];
+
+                    assert(iso8601_unparse(&times[i], flags, 4, f, t,
+                                           sizeof(buf), buf) == 0);
+                    assert(iso8601_parse(buf, &expected) == 0);
+                    fprintf(stderr, "layout: %s\n", buf);
+
+                    if (t == ISO8601_TRUNCATE_NONE && times[i].usecond != 0)
+                        layout.decimals = 6;
+
+                    if (!strchr(buf, 'T'))
+                        layout.zone = ISO8601_ZONE_LOCAL;
+                    else if (times[i].localtime)
+                        layout.zone = ISO8601_ZONE_LOCAL;
+                    else if (times[i].tzminutes == 0)
+                        layout.zone = ISO8601_ZONE_UTC;
+                    else
+                        layout.zone = ISO8601_ZONE_OFFSET;
+
+                    memset(&time, 0, sizeof(time));
+                    assert(iso8601_parse_layout(&layout, buf, strlen(buf),
+                                                NULL, &time) == 0);
+                    assert(memcmp(&time, &expected, sizeof(time)) == 0);
+
+                    layout.zone = ISO8601_ZONE_ANY;
+                    memset(&time, 0, sizeof(time));
+                    assert(iso8601_parse_layout(&layout, buf, SIZE_MAX,
+                                                NULL, &time) == 0);
+                    assert(memcmp(&time, &expected, sizeof(time)) == 0);
+
+                    /* The basic and extended layouts are distinct. */
+                    layout.flags ^= ISO8601_FLAG_BASIC;
+                    if (t != ISO8601_TRUNCATE_YEAR)
+                        assert(iso8601_parse_layout(&layout, buf, strlen(buf),
+                                                    NULL, &time) == EINVAL);
+                }
+            }
+        }
+    }
+
+    /* Mismatched layouts. */
+    assert(iso8601_parse_layout(&canonical, "2010-02-14T13:14:23.123Z",
+                                SIZE_MAX, NULL, &time) == 0);
+    assert(time.usecond == 123000);
+    assert(iso8601_parse_layout(&canonical, "2010-02-14T13:14:23.123Z,",
+                                SIZE_MAX, &end, &time) == 0);
+    assert(*end == ',');
+    assert(iso8601_parse_layout(&canonical, "2010-02-14T13:14:23.12Z",
+                                SIZE_MAX, NULL, &time) == EINVAL);
+    assert(iso8601_parse_layout(&canonical, "2010-02-14T13:14:23.1234Z",
+                                SIZE_MAX, NULL, &time) == EINVAL);
+    assert(iso8601_parse_layout(&canonical, "2010-02-14T13:14:23.123",
+                                SIZE_MAX, NULL, &time) == EINVAL);
+    assert(iso8601_parse_layout(&canonical, "2010-02-14T13:14:23.123+01",
+                                SIZE_MAX, NULL, &time) == EINVAL);
+    assert(iso8601_parse_layout(&canonical, "2010-045T13:14:23.123Z",
+                                SIZE_MAX, NULL, &time) == EINVAL);
+    assert(iso8601_parse_layout(&canonical, "2010-02-30T13:14:23.123Z",
+                                SIZE_MAX, NULL, &time) == EINVAL);
+    assert(iso8601_parse_layout(NULL, "2010", SIZE_MAX, NULL, &time) == EINVAL);
+}
+
+static void
+test_epoch(void)
+{
+    static const struct {
+        const char *string;
+        iso8601_unit unit;
+        int64_t value;
+        int err;
+    } data[] = {
+        { "1970-01-01T00:00:00Z", ISO8601_UNIT_SECOND, 0 },
+        { "1970-01-01T00:00:00.999Z", ISO8601_UNIT_SECOND, 0 },
+        { "1969-12-31T23:59:59.5Z", ISO8601_UNIT_SECOND, -1 },
+        { "1969-12-31T23:59:59.5Z", ISO8601_UNIT_MILLI, -500 },
+        { "2010-02-14T13:14:23.123456789Z", ISO8601_UNIT_SECOND, 1266153263 },
+        { "2010-02-14T13:14:23.123456789Z", ISO8601_UNIT_MILLI,
+          1266153263123 },
+        { "2010-02-14T13:14:23.123456789Z", ISO8601_UNIT_MICRO,
+          1266153263123456 },
+        { "2010-02-14T13:14:23.123456789Z", ISO8601_UNIT_NANO,
+          1266153263123456789 },
+        { "2010-02-14T14:14:23.123456789+01:00", ISO8601_UNIT_NANO,
+          1266153263123456789 },
+        { "2010-02-14T13:14:23.123456789", ISO8601_UNIT_NANO, 0, EDOM },
+        { "2010-02-14T13:14:23.123456789Z!", ISO8601_UNIT_NANO, 0, EINVAL },
+        { "2010-02-14T13:14:23Z", ISO8601_UNIT_NANO + 1, 0, EINVAL },
+        { "1999-12-31T24:00:00Z", ISO8601_UNIT_SECOND, 946684800 },
+        { "2000-12-31T23:59:60Z", ISO8601_UNIT_SECOND, 978307200 },
+        { "2262-04-11T23:47:16.854775807Z", ISO8601_UNIT_NANO,
+          INT64_MAX },
+        { "2262-04-11T23:47:16.854775808Z", ISO8601_UNIT_NANO, 0, ERANGE },
+        { "1677-09-21T00:12:43.145224192Z", ISO8601_UNIT_NANO, INT64_MIN },
+        { "1677-09-21T00:12:43.145224191Z", ISO8601_UNIT_NANO, 0, ERANGE },
+        { "-999999999-01-01T00", ISO8601_UNIT_SECOND, 0, EDOM },
+        { "-999999999-01-01T00Z", ISO8601_UNIT_SECOND, -31557014135596800 },
+        { "+999999999-12-31T24Z", ISO8601_UNIT_MICRO, 0, ERANGE },
+        {}
+    };
+    int64_t epoch;
+
+    for (size_t i = 0; data[i].string != NULL; i++) {
+        fprintf(stderr, "epoch: %s\n", data[i].string);
+        epoch = 0;
+        assert(iso8601_parse_epoch(data[i].string, SIZE_MAX, NULL,
+                                   data[i].unit, NULL, &epoch) == data[i].err);
+        assert(epoch == data[i].value);
+    }
+
+    /* Local time uses the offset given by the caller. */
+    assert(iso8601_parse_epoch("1970-01-01T01:00", SIZE_MAX, NULL,
+                               ISO8601_UNIT_SECOND, &(int16_t) { 60 },
+                               &epoch) == 0);
+    assert(epoch == 0);
+    assert(iso8601_parse_epoch("1970-01-01T01:00Z", SIZE_MAX, NULL,
+                               ISO8601_UNIT_SECOND, &(int16_t) { 60 },
+                               &epoch) == 0);
+    assert(epoch == 3600);
+}
+
+static const struct {
+    const char *string;
+    iso8601_duration duration;
+    bool invalid;
+} DURATION_DATA[] = {
+    { "P1Y2M3DT4H5M6S",     { 1, 2, 0, 3, 4, 5, 6 } },
+    { "P1Y2M3W4DT5H6M7S",   { 1, 2, 3, 4, 5, 6, 7 } },
+    { "P2W",                { .weeks = 2 } },
+    { "P1M",                { .months = 1 } },
+    { "PT1M",               { .minutes = 1 } },
+    { "PT36H",              { .hours = 36 } },
+    { "P0D",                {} },
+    { "PT0S",               {} },
+    { "-P1D",               { .days = 1, .negative = true } },
+    { "P999999999Y",        { .years = 999999999 } },
+    { "P1000000000Y",       { .years = 1000000000 } },
+    { "P4294967295Y",       { .years = 4294967295 } },
+    { "PT4294967295S",      { .seconds = 4294967295 } },
+    { "PT6.5S",             { .seconds = 6, .useconds = 500000 } },
+    { "PT0.123456789S",     { .useconds = 123456, .nseconds = 789 } },
+    { "PT1.5M",             { .minutes = 1, .seconds = 30 } },
+    { "PT0.5H",             { .minutes = 30 } },
+    { "P1.5D",              { .days = 1, .hours = 12 } },
+    { "P0.5W",              { .days = 3, .hours = 12 } },
+    { "P1DT0.000001H",      { .days = 1, .useconds = 3600 } },
+    { "P0003-06-04T12:30:05", { 3, 6, 0, 4, 12, 30, 5 } },
+    { "P00030604T123005.5", { 3, 6, 0, 4, 12, 30, 5, 500000 } },
+    { "P0001-02-03",        { 1, 2, 0, 3 } },
+    { "P20000101",          { 2000, 1, 0, 1 } },
+    { "-P0000-00-01T00:00:00", { .days = 1, .negative = true } },
+    { "P",                  {}, true },
+    { "PT",                 {}, true },
+    { "P1DT",               {}, true },
+    { "P1",                 {}, true },
+    { "1D",                 {}, true },
+    { "P1D1Y",              {}, true },
+    { "PT1S1M",             {}, true },
+    { "P1H",                {}, true },
+    { "PT1D",               {}, true },
+    { "P1.5Y",              {}, true },
+    { "P1.5M",              {}, true },
+    { "P1.5DT1H",           {}, true },
+    { "P1.D",               {}, true },
+    { "P4294967296Y",       {}, true },
+    { "P9999999999Y",       {}, true },
+    { "P10000000000Y",      {}, true },
+    { "P-1D",               {}, true },
+    { "+P1D",               {}, true },
+    { "P0003-13-04",        {}, true },
+    { "P0003-06-31",        {}, true },
+    { "P0003-06-04T25:00:00", {}, true },
+    { "P0003-06-04T12:30",  {}, true },
+    {}
+};
+
+static void
+test_duration(void)
+{
+    iso8601_duration duration;
+    const char *end;
+
+    for (int i = 0; DURATION_DATA[i].string != NULL; i++) {
+        const char *string = DURATION_DATA[i].string;
+
+        fprintf(stderr, "duration: %s\n", string);
+        memset(&duration, 0, sizeof(duration));
+        if (DURATION_DATA[i].invalid) {
+            assert(iso8601_parse_duration(string, SIZE_MAX, NULL,
+                                          &duration) == EINVAL);
+            continue;
+        }
+
+        assert(iso8601_parse_duration(string, SIZE_MAX, NULL,
+                                      &duration) == 0);
+        assert(memcmp(&duration, &DURATION_DATA[i].duration,
+                      sizeof(duration)) == 0);
+    }
+
+    /* A duration may be followed by other text. */
+    assert(iso8601_parse_duration("P1D/2000", SIZE_MAX, &end,
+                                  &duration) == 0);
+    assert(strcmp(end, "/2000") == 0);
+    assert(iso8601_parse_duration("PT1H30", SIZE_MAX, &end,
+                                  &duration) == 0);
+    assert(strcmp(end, "30") == 0);
+    assert(iso8601_parse_duration("P1DT1H", 4, &end, &duration) == 0);
+    assert(strcmp(end, "T1H") == 0);
+    assert(duration.days == 1 && duration.hours == 0);
+    assert(iso8601_parse_duration(NULL, 0, NULL, &duration) == EINVAL);
+}
+
+static void
+test_interval(void)
+{
+    static const struct {
+        const char *string;
+        const char *start;
+        const char *end;
+        int64_t span_us;
+        int err;
+    } data[] = {
+        { "2024-01-01T00:00Z/2024-02-01T00:00Z",
+          "2024-01-01T00:00Z", "2024-02-01T00:00Z", 31 * 86400000000LL },
+        { "2024-01-01/P1M", "2024-01-01", "2024-02-01", 31 * 86400000000LL },
+        { "2024-02-01/P1M", "2024-02-01", "2024-03-01", 29 * 86400000000LL },
+        { "P1M/2024-03-01", "2024-02-01", "2024-03-01", 29 * 86400000000LL },
+        { "2024-01-01T00:00+01:00/PT1.5S",
+          "2024-01-01T00:00+01:00", "2024-01-01T00:00:01.5+01:00", 1500000 },
+        { "2007-12-14T13:30/15:30",
+          "2007-12-14T13:30", "2007-12-14T15:30", 2 * 3600000000LL },
+        { "2008-02-15/03-14", "2008-02-15", "2008-03-14", 28 * 86400000000LL },
+        { "2007-11-13T09:00Z/15:30Z",
+          "2007-11-13T09:00Z", "2007-11-13T15:30Z", 6.5 * 3600000000LL },
+        { "2024-01-01T00:00Z/2024-01-01T01:00+01:00",
+          "2024-01-01T00:00Z", "2024-01-01T01:00+01:00", 0 },
+        { "2024-01-01/2024-01-01", "2024-01-01", "2024-01-01", 0 },
+        { "2024-01-02/2024-01-01", NULL, NULL, 0, EINVAL },
+        { "2024-01-01/-P1D", NULL, NULL, 0, EINVAL },
+        { "2024-01-01/", NULL, NULL, 0, EINVAL },
+        { "/2024-01-01", NULL, NULL, 0, EINVAL },
+        { "P1D/P1D", NULL, NULL, 0, EINVAL },
+        { "2024-01-01", NULL, NULL, 0, EINVAL },
+        { "2024-01-01/P1D/", NULL, NULL, 0, EINVAL },
+        { "2024-01-01T00:00/2024-01-01T01:00", NULL, NULL, 0, EDOM },
+        { "2007-12-14T13:30/1a:30", NULL, NULL, 0, EINVAL },
+        { "2007-12-14T13:30Z/15:30",
+          "2007-12-14T13:30Z", "2007-12-14T15:30Z", 2 * 3600000000LL },
+        { "2007-12-14T13:30+01:00/15:30",
+          "2007-12-14T13:30+01:00", "2007-12-14T15:30+01:00",
+          2 * 3600000000LL },
+        { "2007-12-14T13:30:00.5/15:30:00",
+          "2007-12-14T13:30:00.5", "2007-12-14T15:30:00", 7199500000LL },
+        { "2007-12-14T13:30:00Z/15:30:00.25-01:00", "2007-12-14T13:30:00Z",
+          "2007-12-14T15:30:00.25-01:00", 3 * 3600000000LL + 250000 },
+        { "2007-11-13T09:00Z/15T17:00",
+          "2007-11-13T09:00Z", "2007-11-15T17:00Z", 56 * 3600000000LL },
+        { "20071214T1330Z/1530",
+          "20071214T1330Z", "20071214T1530Z", 2 * 3600000000LL },
+        { "2009-W01-1/3", "2009-W01-1", "2009-W01-3", 2 * 86400000000LL },
+        { "2009W011/W021", "2009W011", "2009W021", 7 * 86400000000LL },
+        { "2008-046/074", "2008-046", "2008-074", 28 * 86400000000LL },
+        { "2008-02/03", "2008-02", "2008-03", 29 * 86400000000LL },
+        { "2024-01-01T10/5", NULL, NULL, 0, EINVAL },
+        { "2024-01-01T10:00/5:30", NULL, NULL, 0, EINVAL },
+        { "2008-02-15/3-14", NULL, NULL, 0, EINVAL },
+        { "2008-02-15/5", NULL, NULL, 0, EINVAL },
+        { "2008-02-15/0314", NULL, NULL, 0, EINVAL },
+        { "2007-12-14T13:30/15:30:", NULL, NULL, 0, EINVAL },
+        { "2007-12-14T13:30/15:30:00", NULL, NULL, 0, EINVAL },
+        { "2009-W01-1/W2-1", NULL, NULL, 0, EINVAL },
+        { "2007-12-14T13:30Z/15:30,5", NULL, NULL, 0, EINVAL },
+        { "2007-12-14T13:30Z/2007-12-14T15:30,5Z", NULL, NULL, 0, EINVAL },
+        {}
+    };
+    iso8601_interval interval;
+    iso8601_time time;
+    const int16_t utc = 0;
+    const char *end;
+
+    for (int i = 0; data[i].string != NULL; i++) {
+        const int16_t *zone = data[i].err == EINVAL ? &utc : NULL;
+        int64_t us;
+
+        fprintf(stderr, "interval: %s\n", data[i].string);
+        if (data[i].start == NULL) {
+            assert(iso8601_parse_interval(data[i].string, SIZE_MAX, NULL,
+                                          zone, &interval) == data[i].err);
+            continue;
+        }
+
+        /* Local endpoints need a zone. */
+        if (strchr(data[i].start, 'Z') == NULL &&
+            strchr(data[i].start, '+') == NULL) {
+            assert(iso8601_parse_interval(data[i].string, SIZE_MAX, NULL,
+                                          NULL, &interval) == EDOM);
+            zone = &utc;
+        }
+
+        memset(&interval, 0, sizeof(interval));
+        assert(iso8601_parse_interval(data[i].string, SIZE_MAX, NULL,
+                                      zone, &interval) == 0);
+        assert(iso8601_parse(data[i].start, &time) == 0);
+        assert(memcmp(&time, &interval.start, sizeof(time)) == 0);
+        assert(iso8601_parse(data[i].end, &time) == 0);
+        assert(memcmp(&time, &interval.end, sizeof(time)) == 0);
+        assert(interval.span_us == data[i].span_us);
+
+        assert(iso8601_parse_epoch(data[i].start, SIZE_MAX, NULL,
+                                   ISO8601_UNIT_MICRO, zone, &us) == 0);
+        assert(interval.start_us == us);
+        assert(!iso8601_interval_contains(&interval, us - 1));
+        assert(iso8601_interval_contains(&interval, us) ==
+               (data[i].span_us > 0));
+        assert(iso8601_interval_contains(&interval,
+                                         us + data[i].span_us - 1) ==
+               (data[i].span_us > 0));
+        assert(!iso8601_interval_contains(&interval, us + data[i].span_us));
+    }
+
+    /* An interval may be followed by other text. */
+    assert(iso8601_parse_interval("2024-01-01Z/P1D,x", SIZE_MAX, &end, NULL,
+                                  &interval) == 0);
+    assert(strcmp(end, ",x") == 0);
+    assert(iso8601_parse_interval("2024-01-01Z/2024-01-02Z x", SIZE_MAX, &end,
+                                  NULL, &interval) == 0);
+    assert(strcmp(end, " x") == 0);
+    assert(iso8601_parse_interval("2024-01-01Z/02Z x", SIZE_MAX, &end,
+                                  NULL, &interval) == 0);
+    assert(strcmp(end, " x") == 0);
+    assert(interval.span_us == 86400000000LL);
+    assert(iso8601_parse_interval(NULL, 0, NULL, NULL, &interval) == EINVAL);
+}
+
+/* Get a time in microseconds since the epoch, taking local times at zone. */
+static int64_t
+epoch_us(const iso8601_time *time, int16_t zone)
+{
+    char buf[64];
+    int64_t us;
+
+    assert(iso8601_unparse(time, 0, 4, ISO8601_FORMAT_NORMAL,
+                           ISO8601_TRUNCATE_NONE, sizeof(buf), buf) == 0);
+    assert(iso8601_parse_epoch(buf, SIZE_MAX, NULL, ISO8601_UNIT_MICRO,
+                               &zone, &us) == 0);
+    return us;
+}
+
+/* Check seeking against a walk through the occurrences. */
+static void
+test_recurrence_seek(const iso8601_recurrence *recurrence, int64_t us)
+{
+    iso8601_recurrence walk = *recurrence;
+    iso8601_recurrence seek = *recurrence;
+    iso8601_time expected;
+    iso8601_time time;
+    int err;
+
+    walk.next = 0;
+    do {
+        err = iso8601_recurrence_next(&walk, &expected);
+    } while (err == 0 && epoch_us(&expected, walk.tzminutes) < us);
+
+    assert(iso8601_recurrence_seek(&seek, us) == err);
+    if (err == 0) {
+        assert(seek.next == walk.next - 1);
+        assert(iso8601_recurrence_next(&seek, &time) == 0);
+        assert(memcmp(&time, &expected, sizeof(time)) == 0);
+    }
+}
+
+static void
+test_recurrence(void)
+{
+    static const struct {
+        const char *string;
+        int64_t count;
+        const char *occurrences[4];
+        int err;
+    } data[] = {
+        { "R/2024-01-01T00:00Z/PT15M", -1,
+          { "2024-01-01T00:00Z", "2024-01-01T00:15Z", "2024-01-01T00:30Z",
+            "2024-01-01T00:45Z" } },
+        { "R3/2024-01-31/P1M", 3,
+          { "2024-01-31", "2024-03-02", "2024-03-31" } },
+        { "R2/2024-01-01T00:00Z/2024-01-01T00:00:01.5Z", 2,
+          { "2024-01-01T00:00Z", "2024-01-01T00:00:01.5Z" } },
+        { "R2/P1D/2024-01-10Z", 2, { "2024-01-08Z", "2024-01-09Z" } },
+        { "R0/2024-01-01Z/P1D", 0, {} },
+        { "R/2024-02-29Z/P1Y", -1,
+          { "2024-02-29Z", "2025-03-01Z", "2026-03-01Z", "2027-03-01Z" } },
+        { "R/2024-01-01Z/PT0.000000001S", -1,
+          { "2024-01-01Z", "2024-01-01T00:00:00.000000001Z",
+            "2024-01-01T00:00:00.000000002Z",
+            "2024-01-01T00:00:00.000000003Z" } },
+        { "R/P1D/2024-01-10Z", 0, {}, EINVAL },
+        { "R/2024-01-01Z/PT0S", 0, {}, EINVAL },
+        { "R/2024-01-01Z/-P1D", 0, {}, EINVAL },
+        { "R/2024-01-01Z/2024-01-01Z", 0, {}, EINVAL },
+        { "R1234567890123456789/2024-01-01Z/P1D", 0, {}, EINVAL },
+        { "R5000000000/P1D/2024-01-01Z", 0, {}, ERANGE },
+        { "R/2024-01-01/P1D", 0, {}, EDOM },
+        { "R2024-01-01Z/P1D", 0, {}, EINVAL },
+        { "2024-01-01Z/P1D", 0, {}, EINVAL },
+        { "R/2024-01-01Z", 0, {}, EINVAL },
+        {}
+    };
+    const int16_t est = -300;
+    const int16_t utc = 0;
+    iso8601_recurrence recurrence;
+    iso8601_time time;
+    const char *end;
+
+    for (int i = 0; data[i].string != NULL; i++) {
+        iso8601_recurrence copy;
+        int j;
+
+        fprintf(stderr, "recurrence: %s\n", data[i].string);
+        assert(iso8601_parse_recurrence(data[i].string, SIZE_MAX, NULL,
+                                        data[i].err == EDOM ? NULL : &utc,
+                                        &recurrence) == data[i].err);
+        if (data[i].err != 0)
+            continue;
+        assert(recurrence.count == data[i].count);
+        copy = recurrence;
+
+        for (j = 0; j < 4 && data[i].occurrences[j] != NULL; j++) {
+            iso8601_time expected;
+
+            assert(iso8601_parse(data[i].occurrences[j], &expected) == 0);
+            assert(iso8601_recurrence_next(&recurrence, &time) == 0);
+            assert(memcmp(&time, &expected, sizeof(time)) == 0);
+        }
+        if (data[i].count >= 0)
+            assert(iso8601_recurrence_next(&recurrence, &time) == ENOENT);
+
+        /* Seek to, between and around the occurrences. */
+        for (j = 0; j < 4 && data[i].occurrences[j] != NULL; j++) {
+            int64_t us;
+
+            assert(iso8601_parse_epoch(data[i].occurrences[j], SIZE_MAX, NULL,
+                                       ISO8601_UNIT_MICRO, &utc, &us) == 0);
+            test_recurrence_seek(&copy, us - 1);
+            test_recurrence_seek(&copy, us);
+            test_recurrence_seek(&copy, us + 1);
+        }
+        test_recurrence_seek(&copy, INT64_MIN);
+    }
+
+    /* Local starts take the given zone, which seeking then uses. */
+    assert(iso8601_parse_recurrence("R/2024-01-01T09:00/PT1H", SIZE_MAX,
+                                    NULL, &est, &recurrence) == 0);
+    assert(recurrence.tzminutes == -300);
+    assert(iso8601_recurrence_seek(&recurrence,
+                                   1704117600000000LL /* 14:00Z */) == 0);
+    assert(recurrence.next == 0);
+    assert(iso8601_recurrence_seek(&recurrence, 1704117600000001LL) == 0);
+    assert(recurrence.next == 1);
+
+    /* Seeking far ahead is arithmetic; the answer is checked around it. */
+    assert(iso8601_parse_recurrence("R/2000-01-31T00:00:00.5Z/P1M1DT1.25S",
+                                    SIZE_MAX, NULL, NULL, &recurrence) == 0);
+    for (int i = 0; i < 1000; i++) {
+        const int64_t us = 946598400000000LL +
+                           (int64_t) rand() * rand() % 3155760000000000LL;
+        iso8601_recurrence before;
+
+        assert(iso8601_recurrence_seek(&recurrence, us) == 0);
+        assert(recurrence.next > 0);
+        before = recurrence;
+        before.next--;
+        assert(iso8601_recurrence_next(&before, &time) == 0);
+        assert(epoch_us(&time, 0) < us);
+        assert(iso8601_recurrence_next(&before, &time) == 0);
+        assert(epoch_us(&time, 0) >= us);
+    }
+
+    /* Unbounded recurrences end where the years or the index run out. */
+    assert(iso8601_parse_recurrence("R/2024-01-01Z/P999999999Y", SIZE_MAX,
+                                    NULL, NULL, &recurrence) == 0);
+    for (int i = 0; i < 3; i++)
+        assert(iso8601_recurrence_next(&recurrence, &time) == 0);
+    assert(time.year == 2000002022);
+    assert(iso8601_recurrence_next(&recurrence, &time) == ENOENT);
+    assert(iso8601_parse_recurrence("R/2024-01-01T00Z/PT0.000000001S",
+                                    SIZE_MAX, NULL, NULL, &recurrence) == 0);
+    assert(iso8601_recurrence_seek(&recurrence, INT64_MAX) == ENOENT);
+    assert(recurrence.next == INT64_MAX);
+
+    /* A recurrence may be followed by other text. */
+    assert(iso8601_parse_recurrence("R5/2024-01-01Z/P1D,x", SIZE_MAX, &end,
+                                    NULL, &recurrence) == 0);
+    assert(strcmp(end, ",x") == 0);
+    assert(iso8601_parse_recurrence(NULL, 0, NULL, NULL,
+                                    &recurrence) == EINVAL);
+    assert(iso8601_recurrence_next(NULL, &time) == EINVAL);
+    assert(iso8601_recurrence_seek(NULL, 0) == EINVAL);
+}
+
+/*
+ * Feed a stream in chunks of every size. The last timestamp is returned by
+ * iso8601_push_finish(); a NULL is expected where the parser fails.
+ */
+static void
+test_push_stream(const char *stream, const char *const *expected,
+                 size_t count)
+{
+    const size_t len = strlen(stream);
+    iso8601_push_parser push = {};
+    iso8601_time want;
+    iso8601_time time;
+    size_t used;
+
+    for (size_t chunk = 1; chunk <= len + 1; chunk++) {
+        size_t n = 0;
+        size_t pos = 0;
+
+        fprintf(stderr, "push: chunk %zu\n", chunk);
+        while (pos < len) {
+            size_t left = len - pos;
+            int err;
+
+            if (left > chunk)
+                left = chunk;
+
+            err = iso8601_push_parse(&push, &stream[pos], left, &used, &time);
+            pos += used;
+            if (err == EAGAIN)
+                continue;
+
+            if (expected[n] == NULL) {
+                assert(err == EINVAL);
+            } else {
+                assert(err == 0);
+                assert(iso8601_parse(expected[n], &want) == 0);
+                assert(memcmp(&time, &want, sizeof(time)) == 0);
+            }
+            n++;
+        }
+
+        assert(iso8601_push_finish(&push, &time) == 0);
+        assert(iso8601_parse(expected[n], &want) == 0);
+        assert(memcmp(&time, &want, sizeof(time)) == 0);
+        assert(n + 1 == count);
+        assert(iso8601_push_finish(&push, &time) == ENOENT);
+    }
+}
+
+static void
+test_push(void)
+{
+    static const char *const expected[] = {
+        "2024-01-01T00:00:00Z", "2024-02-29T12:30:00.5+01:00",
+        "20240301T12Z", NULL, NULL, "2024-W01-1", NULL, NULL, "2024-03-02",
+    };
+    static const char *const lines[] = {
+        "2024-01-01T00:00:00Z", "2024-02-29T12:30:00.5+01:00", NULL,
+        "20240301T12Z", NULL, NULL, "2024-03-02",
+    };
+    iso8601_push_parser push = {};
+    char long_stamp[100];
+    iso8601_time want;
+    iso8601_time time;
+    size_t used;
+
+    /* Anything else, or nothing, between delimiters is invalid. */
+    test_push_stream("2024-01-01T00:00:00Z,2024-02-29T12:30:00.5+01:00\n"
+                     "20240301T12Z x 2024-W01-1 2024-13-01,,2024-03-02",
+                     expected, sizeof(expected) / sizeof(*expected));
+
+    /* CRLF ends a line once; empty lines and a lone CR or LF don't. */
+    test_push_stream("2024-01-01T00:00:00Z\r\n"
+                     "2024-02-29T12:30:00.5+01:00\r\n\r\n"
+                     "20240301T12Z\r\n\n\r2024-03-02",
+                     lines, sizeof(lines) / sizeof(*lines));
+
+    /* A split timestamp which doesn't fit is rejected as a whole. */
+    memset(long_stamp, '1', sizeof(long_stamp));
+    memcpy(long_stamp, "2024-01-01T00:00:00.", 20);
+    assert(iso8601_push_parse(&push, long_stamp, 50, &used,
+                              &time) == EAGAIN);
+    assert(iso8601_push_parse(&push, &long_stamp[50], 50, &used,
+                              &time) == EAGAIN);
+    assert(iso8601_push_parse(&push, "1 ", 2, &used, &time) == EINVAL);
+    assert(used == 2);
+    assert(iso8601_push_parse(&push, "2024-01-01 ", 11, &used, &time) == 0);
+    assert(iso8601_push_parse(&push, long_stamp, 50, &used, &time) == EAGAIN);
+    assert(iso8601_push_parse(&push, &long_stamp[50], 50, &used,
+                              &time) == EAGAIN);
+    assert(iso8601_push_finish(&push, &time) == EINVAL);
+
+    /* In one chunk, it is parsed in place. */
+    long_stamp[sizeof(long_stamp) - 1] = ' ';
+    assert(iso8601_push_parse(&push, long_stamp, sizeof(long_stamp), &used,
+                              &time) == 0);
+    assert(used == sizeof(long_stamp));
+
+    /* A chunk may start with the delimiter of the buffered timestamp. */
+    assert(iso8601_push_parse(&push, "2024-01", 7, &used, &time) == EAGAIN);
+    assert(iso8601_push_parse(&push, "-01\n2024-01-02,", 15, &used,
+                              &time) == 0);
+    assert(used == 4);
+    assert(iso8601_parse("2024-01-01", &want) == 0);
+    assert(memcmp(&time, &want, sizeof(time)) == 0);
+    assert(iso8601_push_parse(&push, "2024-01", 7, &used, &time) == EAGAIN);
+    assert(iso8601_push_parse(&push, " 2024-01-03 ", 12, &used,
+                              &time) == 0);
+    assert(used == 1);
+    assert(iso8601_parse("2024-01", &want) == 0);
+    assert(memcmp(&time, &want, sizeof(time)) == 0);
+    assert(iso8601_push_parse(&push, "2024-01-03 ", 11, &used, &time) == 0);
+    assert(used == 11);
+
+    /* With nothing buffered, a leading delimiter ends an empty timestamp. */
+    assert(iso8601_push_parse(&push, " 2024-01-04 ", 12, &used,
+                              &time) == EINVAL);
+    assert(used == 1);
+    assert(iso8601_push_parse(&push, "2024-01-04 ", 11, &used, &time) == 0);
+    assert(used == 11);
+    assert(iso8601_push_finish(&push, &time) == ENOENT);
+    assert(iso8601_push_parse(NULL, "", 0, &used, &time) == EINVAL);
+    assert(iso8601_push_finish(NULL, &time) == EINVAL);
+}
+
+static void
+test_parser_one(iso8601_parser *p, const char *in, bool prefix,
+                uint64_t hits, uint64_t misses)
+{
+    const char *pend = NULL;
+    const char *end = NULL;
+    iso8601_time expected;
+    iso8601_time time;
+
+    fprintf(stderr, "parser: %s\n", in);
+
+    memset(&expected, 0, sizeof(expected));
+    memset(&time, 0, sizeof(time));
+    assert(iso8601_parse_n(in, SIZE_MAX, prefix ? &end : NULL, &expected) == 0);
+    assert(iso8601_parser_parse(p, in, SIZE_MAX, prefix ? &pend : NULL,
+                                &time) == 0);
+    assert(memcmp(&time, &expected, sizeof(time)) == 0);
+    assert(pend == end);
+    assert(p->hits == hits);
+    assert(p->misses == misses);
+}
+
+static void
+test_parser(void)
+{
+    iso8601_parser p = {};
+    iso8601_time time;
+
+    /* A stream of timestamps with the same layout only misses once. */
+    test_parser_one(&p, "2010-02-14T13:14:23.123+01:00", false, 0, 1);
+    test_parser_one(&p, "2011-03-15T14:15:24.456-05:30", false, 1, 1);
+    test_parser_one(&p, "2012-04-16T15:16:25.789+00:00", false, 2, 1);
+    assert(p.learned);
+    assert(p.layout.format == ISO8601_FORMAT_NORMAL);
+    assert(p.layout.truncate == ISO8601_TRUNCATE_SECOND);
+    assert(p.layout.flags == ISO8601_FLAG_NONE);
+    assert(p.layout.decimals == 3);
+    assert(p.layout.zone == ISO8601_ZONE_OFFSET);
+
+    /* A different layout misses and is learned in turn. */
+    test_parser_one(&p, "2010W067T1314Z", false, 2, 2);
+    test_parser_one(&p, "2010W011T0000Z", false, 3, 2);
+    test_parser_one(&p, "2010-045", false, 3, 3);
+    test_parser_one(&p, "2010-046", false, 4, 3);
+
+    /* Invalid input is a miss and doesn't forget the layout. */
+    assert(iso8601_parser_parse(&p, "2010-366", SIZE_MAX, NULL,
+                                &time) == EINVAL);
+    assert(p.misses == 4);
+    test_parser_one(&p, "2010-047", false, 5, 4);
+
+    /* An offset after a year or a month is never learned. */
+    test_parser_one(&p, "2010-02+05", false, 5, 5);
+    test_parser_one(&p, "2010-02-05", false, 5, 6);
+    test_parser_one(&p, "2010-02-06", false, 6, 6);
+
+    /* Prefixes only hit where detection would have stopped as well. */
+    test_parser_one(&p, "2010-02-14T13 ", true, 6, 7);
+    test_parser_one(&p, "2010-02-14T14,", true, 7, 7);
+    test_parser_one(&p, "2010-02-14T13:14 ", true, 7, 8);
+    test_parser_one(&p, "2010-02-14T13:14.5 ", true, 7, 9);
+    test_parser_one(&p, "2010-02-14T13:14.5Z", true, 7, 10);
+
+    assert(iso8601_parser_parse(NULL, "2010", SIZE_MAX, NULL, &time) == EINVAL);
+    assert(iso8601_parser_parse(&p, NULL, SIZE_MAX, NULL, &time) == EINVAL);
+}
+
+static void
+test_scan(void)
+{
+    static const struct {
+        const char *text;
+        const char *found[5];
+    } data[] = {
+        { "", {} },
+        { "no timestamps here", {} },
+        { "2010-02-14T13:14:23Z", { "2010-02-14T13:14:23Z" } },
+        { "[2010-02-14 13:14:23.123] started", { "2010-02-14" } },
+        { "at 2010-02-14T13:14:23.123+01:00, then 20100214T1314Z.",
+          { "2010-02-14T13:14:23.123+01:00", "20100214T1314Z" } },
+        { "2010-W06-7 2010-045T10 2010045T10 2010-02",
+          { "2010-W06-7", "2010-045T10", "2010045T10", "2010-02" } },
+        { "id=x2010-02-14 2010-02-14x 12010-02-14 20100214 2010-",
+          {} },
+        { "2010-2015 2010-02-30 pages 555-1234", {} },
+        { "2010-02-14T13:14:23Zabc 2010-02-14T25", {} },
+    };
+
+    for (size_t i = 0; i < sizeof(data) / sizeof(*data); i++) {
+        const char *text = data[i].text;
+        iso8601_match match;
+        size_t pos = 0;
+        size_t j = 0;
+
+        fprintf(stderr, "scan: %s\n", text);
+
+        while (iso8601_scan(text, SIZE_MAX, &pos, &match) == 0) {
+            const char *found = data[i].found[j++];
+            iso8601_time time;
+
+            assert(found != NULL);
+            assert(match.length == strlen(found));
+            assert(strncmp(&text[match.offset], found, match.length) == 0);
+            assert(pos == match.offset + match.length);
+
+            assert(iso8601_parse(found, &time) == 0);
+            assert(memcmp(&time, &match.time, sizeof(time)) == 0);
+        }
+
+        assert(data[i].found[j] == NULL);
+        assert(pos == strlen(text));
+    }
+
+    /* Timestamps are found wherever they fall in a longer text. */
+    for (size_t i = 0; i < 48; i++) {
+        const char *ts = "2010-02-14T13:14:23Z";
+        char text[128];
+        iso8601_match match;
+        size_t pos = 0;
+        size_t len;
+
+        memset(text, '.', i);
+        len = i + snprintf(&text[i], sizeof(text) - i, "%s%.*s", ts,
+                           (int) (i % 17), "-T-T-T-T-T-T-T-T-");
+
+        assert(iso8601_scan(text, len, &pos, &match) == 0);
+        assert(match.offset == i);
+        assert(match.length == strlen(ts));
+        assert(iso8601_scan(text, len, &pos, &match) == ENOENT);
+        assert(pos == len);
+
+        /* The length bounds the search. */
+        pos = 0;
+        assert(iso8601_scan(text, i + 10, &pos, &match) == 0);
+        assert(match.length == 10);
+    }
+
+    /* A NUL-terminated text is scanned in one pass, up to its NUL. */
+    {
+        const char *ts = "2010-02-14T13:14:23Z - ";
+        const size_t count = 10000;
+        const size_t size = strlen(ts);
+        char *text = malloc(count * size + 1);
+        iso8601_match match;
+        size_t pos = 0;
+        size_t j = 0;
+
+        assert(text != NULL);
+        for (size_t i = 0; i < count; i++)
+            memcpy(&text[i * size], ts, size);
+        text[count * size] = '\0';
+
+        while (iso8601_scan(text, SIZE_MAX, &pos, &match) == 0) {
+            assert(match.offset == j * size);
+            assert(match.length == 20);
+            j++;
+        }
+
+        assert(j == count);
+        assert(pos == count * size);
+        free(text);
+    }
+}
+
 static char
 hex(char v)
 {
@@ -285,10 +1423,25 @@ main(int argc, const char **argv)
     setenv("TZ", TZ, 1);
 
     assert(iso8601_parse(NULL, NULL) == EINVAL);
+    assert(iso8601_validate(NULL, 0) == EINVAL);
 
     for (int i = 0; TEST_DATA[i].string != NULL; i++)
         test(&TEST_DATA[i]);
 
+    test_prefix();
+    test_batch();
+    test_column();
+    test_layout();
+    test_decimal();
+    test_epoch();
+    test_duration();
+    test_interval();
+    test_recurrence();
+    test_parser();
+    test_push();
+    test_scan();
+    test_fast();
+
     rnd = fopen("/dev/urandom", "r");
     assert(rnd);
 
@@ -308,6 +1461,18 @@ main(int argc, const char **argv)
         fputc('\n', stderr);
 
         (void) iso8601_parse(buf, &out);
+        (void) iso8601_parse_n(buf, rand() % (len + 1), NULL, &out);
+        assert(iso8601_validate(buf, len) ==
+               iso8601_parse_n(buf, len, NULL, &out));
+        (void) iso8601_parser_parse(&parser, buf, len, NULL, &out);
+
+        for (size_t pos = 0; pos < len; ) {
+            iso8601_match match;
+
+            if (iso8601_scan(buf, len, &pos, &match) != 0)
+                break;
+            assert(match.offset + match.length == pos);
+        }
     }
 
     fclose(rnd);
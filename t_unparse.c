@@ -237,6 +237,31 @@ struct {
     { ISO8601_TRUNCATE_NONE, ISO8601_FORMAT_WEEKDATE, 4, ISO8601_FLAG_NONE,
         { 2000, 12, 31, 23, 59, 60, 0, true }, "2000-W52-7T23:59:60" },
 
+    /* Decimal Precision */
+    { ISO8601_TRUNCATE_NONE, ISO8601_FORMAT_NORMAL, 4, ISO8601_FLAG_NONE,
+        { 2000, 3, 3, 3, 3, 3, 123456, false, 0, 789 },
+        "2000-03-03T03:03:03.123456789Z" },
+    { ISO8601_TRUNCATE_NONE, ISO8601_FORMAT_NORMAL, 4, ISO8601_FLAG_NONE,
+        { 2000, 3, 3, 3, 3, 3, 0, false, 0, 1 },
+        "2000-03-03T03:03:03.000000001Z" },
+    { ISO8601_TRUNCATE_NONE, ISO8601_FORMAT_NORMAL, 4, ISO8601_FLAG_MILLI,
+        { 2000, 3, 3, 3, 3, 3, 123456, false, 0, 789 },
+        "2000-03-03T03:03:03.123Z" },
+    { ISO8601_TRUNCATE_NONE, ISO8601_FORMAT_NORMAL, 4, ISO8601_FLAG_MICRO,
+        { 2000, 3, 3, 3, 3, 3, 123456, false, 0, 789 },
+        "2000-03-03T03:03:03.123456Z" },
+    { ISO8601_TRUNCATE_NONE, ISO8601_FORMAT_NORMAL, 4, ISO8601_FLAG_NANO,
+        { 2000, 3, 3, 3, 3, 3, 123456, false, 0, 789 },
+        "2000-03-03T03:03:03.123456789Z" },
+    { ISO8601_TRUNCATE_NONE, ISO8601_FORMAT_NORMAL, 4, ISO8601_FLAG_MILLI,
+        { 2000, 3, 3, 3, 3, 3 }, "2000-03-03T03:03:03.000Z" },
+    { ISO8601_TRUNCATE_NONE, ISO8601_FORMAT_NORMAL, 4,
+        ISO8601_FLAG_BASIC | ISO8601_FLAG_NANO,
+        { 2000, 3, 3, 3, 3, 3, 5 }, "20000303T030303.000005000Z" },
+    { ISO8601_TRUNCATE_SECOND, ISO8601_FORMAT_NORMAL, 4, ISO8601_FLAG_NANO,
+        { 2000, 3, 3, 3, 3, 3, 123456, false, 0, 789 },
+        "2000-03-03T03:03:03Z" },
+
     /* Large Year */
     { ISO8601_TRUNCATE_YEAR, ISO8601_FORMAT_NORMAL, 5, ISO8601_FLAG_NONE,
         { 11111, 1, 1 }, "+11111" },
@@ -275,6 +300,12 @@ struct {
         { 2000, 2, 11, 24, 0, 1 } },
     { ISO8601_TRUNCATE_NONE, ISO8601_FORMAT_NORMAL, 4, ISO8601_FLAG_NONE,
         { 2000, 2, 11, 24, 0, 0, 1 } },
+    { ISO8601_TRUNCATE_NONE, ISO8601_FORMAT_NORMAL, 4, ISO8601_FLAG_NONE,
+        { 2000, 2, 11, 24, 0, 0, 0, false, 0, 1 } },
+    { ISO8601_TRUNCATE_NONE, ISO8601_FORMAT_NORMAL, 4, ISO8601_FLAG_NONE,
+        { 2000, 2, 11, 0, 0, 0, 0, false, 0, 1000 } },
+    { ISO8601_TRUNCATE_NONE, ISO8601_FORMAT_NORMAL, 4,
+        ISO8601_FLAG_MILLI | ISO8601_FLAG_NANO, { 2000, 2, 11 } },
     { ISO8601_TRUNCATE_NONE, ISO8601_FORMAT_NORMAL, 4, ISO8601_FLAG_NONE,
         { 2000, 2, 11, 23, 59, 60 } },
     { ISO8601_TRUNCATE_NONE, ISO8601_FORMAT_NORMAL, 4, ISO8601_FLAG_NONE,
@@ -308,9 +339,481 @@ static void test_e2big(iso8601_format format)
         r = iso8601_unparse(&time, ISO8601_FLAG_NONE, 4, format,
                             ISO8601_TRUNCATE_NONE, i, buf);
         assert(r == 0 || r == E2BIG);
+
+        /* The first buffer which is big enough is filled exactly. */
+        assert(r == E2BIG || strlen(buf) == i - 1);
+    }
+}
+
+/* Check that a formatter writes the same as iso8601_unparse() did. */
+static void test_formatter(size_t i)
+{
+    const uint32_t decimal = tests[i].flags & (ISO8601_FLAG_MILLI |
+                                               ISO8601_FLAG_MICRO |
+                                               ISO8601_FLAG_NANO);
+    const iso8601_time *time = &tests[i].time;
+    const uint32_t basic = tests[i].flags & ISO8601_FLAG_BASIC;
+    iso8601_formatter formatter;
+    uint8_t precision;
+    char buf[64];
+    size_t len;
+    int ret;
+
+    switch (decimal) {
+    case ISO8601_FLAG_MILLI:
+        precision = 3;
+        break;
+    case ISO8601_FLAG_MICRO:
+        precision = 6;
+        break;
+    case ISO8601_FLAG_NANO:
+        precision = 9;
+        break;
+    case 0:
+        precision = time->nsecond ? 9 : time->usecond ? 6 : 0;
+        break;
+    default:
+        assert(iso8601_formatter_init(tests[i].flags, tests[i].ydigits,
+                                      tests[i].format, tests[i].truncate,
+                                      3, &formatter) == EINVAL);
+        return;
+    }
+
+    ret = iso8601_formatter_init(basic, tests[i].ydigits, tests[i].format,
+                                 tests[i].truncate, precision, &formatter);
+    if (tests[i].ydigits < 2 || tests[i].ydigits > 9) {
+        assert(ret == EINVAL);
+        return;
+    }
+    assert(ret == 0);
+
+    ret = iso8601_formatter_write(&formatter, time, sizeof(buf), buf, &len);
+    assert(ret == (tests[i].str ? 0 : EINVAL));
+    if (!tests[i].str)
+        return;
+
+    assert(strcmp(buf, tests[i].str) == 0);
+    assert(len == strlen(buf));
+
+    /* Exactly the right size of buffer fits, and no smaller. */
+    assert(iso8601_formatter_write(&formatter, time, len, buf,
+                                   NULL) == E2BIG);
+    assert(iso8601_formatter_write(&formatter, time, len + 1, buf,
+                                   NULL) == 0);
+    assert(strcmp(buf, tests[i].str) == 0);
+
+    /* Trusting a valid time changes nothing. */
+    assert(iso8601_formatter_init(basic | ISO8601_FLAG_TRUSTED,
+                                  tests[i].ydigits, tests[i].format,
+                                  tests[i].truncate, precision,
+                                  &formatter) == 0);
+    assert(iso8601_formatter_write(&formatter, time, sizeof(buf), buf,
+                                   NULL) == 0);
+    assert(strcmp(buf, tests[i].str) == 0);
+}
+
+static void test_formatter_precision(void)
+{
+    static const iso8601_time time = { 2000, 3, 3, 3, 3, 3, 123456, false,
+                                       -90, 789 };
+    static const char *const expected[] = {
+        "2000-03-03T03:03:03-01:30",
+        "2000-03-03T03:03:03.1-01:30",
+        "2000-03-03T03:03:03.12-01:30",
+        "2000-03-03T03:03:03.123-01:30",
+        "2000-03-03T03:03:03.1234-01:30",
+        "2000-03-03T03:03:03.12345-01:30",
+        "2000-03-03T03:03:03.123456-01:30",
+        "2000-03-03T03:03:03.1234567-01:30",
+        "2000-03-03T03:03:03.12345678-01:30",
+        "2000-03-03T03:03:03.123456789-01:30",
+    };
+    iso8601_formatter formatter;
+    char buf[64];
+
+    for (uint8_t i = 0; i < sizeof(expected) / sizeof(*expected); i++) {
+        assert(iso8601_formatter_init(ISO8601_FLAG_NONE, 4,
+                                      ISO8601_FORMAT_NORMAL,
+                                      ISO8601_TRUNCATE_NONE, i,
+                                      &formatter) == 0);
+        assert(iso8601_formatter_write(&formatter, &time, sizeof(buf), buf,
+                                       NULL) == 0);
+        assert(strcmp(buf, expected[i]) == 0);
+    }
+
+    /* Years which don't fit the pattern are written in full. */
+    assert(iso8601_formatter_init(ISO8601_FLAG_BASIC, 4,
+                                  ISO8601_FORMAT_WEEKDATE,
+                                  ISO8601_TRUNCATE_DAY, 0, &formatter) == 0);
+    assert(iso8601_formatter_write(&formatter,
+                                   &(iso8601_time) { 12345, 1, 5 },
+                                   sizeof(buf), buf, NULL) == 0);
+    assert(strcmp(buf, "+12345W015") == 0);
+    assert(iso8601_formatter_write(&formatter,
+                                   &(iso8601_time) { -1, 1, 5 },
+                                   sizeof(buf), buf, NULL) == 0);
+    assert(strcmp(buf, "-0001W012") == 0);
+
+    assert(iso8601_formatter_init(ISO8601_FLAG_NONE, 4,
+                                  ISO8601_FORMAT_NORMAL,
+                                  ISO8601_TRUNCATE_NONE, 10,
+                                  &formatter) == EINVAL);
+    assert(iso8601_formatter_init(ISO8601_FLAG_MICRO, 4,
+                                  ISO8601_FORMAT_NORMAL,
+                                  ISO8601_TRUNCATE_NONE, 6,
+                                  &formatter) == EINVAL);
+    assert(iso8601_formatter_init(ISO8601_FLAG_NONE, 4,
+                                  ISO8601_FORMAT_NORMAL,
+                                  ISO8601_TRUNCATE_NONE, 6, NULL) == EINVAL);
+    assert(iso8601_formatter_write(&formatter, NULL, sizeof(buf), buf,
+                                   NULL) == EINVAL);
+}
+
+static void test_column(void)
+{
+    static const iso8601_time times[] = {
+        { 2000, 3, 3, 3, 3, 3, 123456 },
+        { 1999, 12, 31, 23, 59, 60 },
+        { 2000, 2, 30 },
+        { 12345, 1, 1, 0, 0, 0, 5 },
+        { 2000, 3, 3, 3, 3, 3, 0, false, 90 },
+        { 2000, 3, 3, 3, 3, 3, 0, true },
+    };
+    const size_t n = sizeof(times) / sizeof(*times);
+    iso8601_formatter formatter;
+    int32_t offsets32[n + 1];
+    int64_t offsets64[n + 1];
+    int status[n];
+    char data[n * ISO8601_FORMATTER_MAX];
+    char buf[64];
+    int32_t years[n];
+    iso8601_columns columns = { .year = years };
+
+    assert(iso8601_formatter_init(ISO8601_FLAG_NONE, 4,
+                                  ISO8601_FORMAT_NORMAL,
+                                  ISO8601_TRUNCATE_NONE, 6,
+                                  &formatter) == 0);
+
+    /* Each string is what iso8601_formatter_write() would write. */
+    memset(status, 0xff, sizeof(status));
+    assert(iso8601_unparse_column32(&formatter, times, n, data,
+                                    sizeof(data), offsets32,
+                                    status) == EINVAL);
+    assert(iso8601_unparse_column64(&formatter, times, n, data,
+                                    sizeof(data), offsets64,
+                                    NULL) == EINVAL);
+    assert(offsets32[0] == 0);
+    for (size_t i = 0; i < n; i++) {
+        const int32_t len = offsets32[i + 1] - offsets32[i];
+        int ret;
+
+        assert(offsets64[i + 1] == offsets32[i + 1]);
+        ret = iso8601_formatter_write(&formatter, &times[i], sizeof(buf),
+                                      buf, NULL);
+        assert(status[i] == ret);
+        if (ret != 0) {
+            assert(len == 0);
+            continue;
+        }
+
+        assert(len == (int32_t) strlen(buf));
+        assert(memcmp(&data[offsets32[i]], buf, len) == 0);
+    }
+
+    /* The column reads back. */
+    assert(iso8601_parse_column32(data, offsets32, n, &columns,
+                                  status) == EINVAL);
+    assert(status[2] == EINVAL && years[3] == 12345);
+
+    /* A short buffer stops at the element which doesn't fit. */
+    assert(iso8601_unparse_column32(&formatter, times, n, data,
+                                    offsets32[2] + 1, offsets32,
+                                    status) == E2BIG);
+    assert(status[1] == 0 && status[3] == E2BIG);
+    assert(iso8601_unparse_column32(&formatter, times, 0, NULL, 0,
+                                    offsets32, NULL) == 0);
+    assert(offsets32[0] == 0);
+    assert(iso8601_unparse_column32(&formatter, times, 1, data,
+                                    sizeof(data), NULL, NULL) == EINVAL);
+
+    /* In fixed width, only UTC times of four digit years fit. */
+    memset(data, 'x', sizeof(data));
+    assert(iso8601_unparse_fixed(&formatter, times, n, formatter.len + 1,
+                                 data, status) == EINVAL);
+    assert(status[0] == 0 && status[1] == 0);
+    assert(memcmp(data, "2000-03-03T03:03:03.123456Z", 27) == 0);
+    assert(memcmp(&data[27], "1999-12-31T23:59:60.000000Z", 27) == 0);
+    assert(status[2] == EINVAL && status[3] == E2BIG);
+    assert(status[4] == E2BIG && status[5] == EINVAL);
+    for (size_t i = 2 * 27; i < n * 27; i++)
+        assert(data[i] == '\0');
+    assert(data[n * 27] == 'x');
+}
+
+/* Write a walk through time with an incremental formatter. */
+static void test_incremental_walk(uint32_t flags, iso8601_format format,
+                                  iso8601_truncate truncate,
+                                  uint8_t precision)
+{
+    iso8601_incremental incremental = {};
+    iso8601_time time = { 2016, 12, 31, 23, 58, 0, 0, false, 90 };
+    char expected[64];
+    char buf[64];
+    size_t len;
+
+    assert(iso8601_formatter_init(flags, 4, format, truncate, precision,
+                                  &incremental.formatter) == 0);
+
+    for (int i = 0; i < 2000; i++) {
+        int ret;
+
+        /* Mostly small steps, with a jump to a new day now and then. */
+        iso8601_add_useconds(&time, i * 7919 % 1500000);
+        if (i % 97 == 0)
+            iso8601_add_days(&time, 1);
+        if (i % 301 == 0)
+            time.localtime = !time.localtime;
+        time.nsecond = i % 3 == 0 ? i % 1000 : 0;
+
+        ret = iso8601_formatter_write(&incremental.formatter, &time,
+                                      sizeof(expected), expected, NULL);
+        assert(iso8601_incremental_write(&incremental, &time, sizeof(buf),
+                                         buf, &len) == ret);
+        assert(ret == 0);
+        assert(strcmp(buf, expected) == 0);
+        assert(len == strlen(expected));
     }
 }
 
+static void test_incremental(void)
+{
+    static const struct {
+        iso8601_time time;
+        const char *str;
+    } steps[] = {
+        { { 2016, 12, 31, 23, 59, 58, 5 }, "2016-12-31T23:59:58.000005Z" },
+        { { 2016, 12, 31, 23, 59, 59, 250 }, "2016-12-31T23:59:59.000250Z" },
+        { { 2016, 12, 31, 23, 59, 60, 0 }, "2016-12-31T23:59:60.000000Z" },
+        { { 2016, 12, 31, 23, 59, 60, 1 }, NULL },
+        { { 2016, 12, 31, 23, 59, 61 }, NULL },
+        { { 2016, 12, 31, 23, 59, 59, 1000000 }, NULL },
+        { { 2016, 12, 31, 23, 59, 59, 0, false, 0, 1000 }, NULL },
+        { { 2016, 12, 31, 23, 59, 59, 999999 },
+          "2016-12-31T23:59:59.999999Z" },
+        { { 2016, 12, 31, 24 }, "2016-12-31T24:00:00.000000Z" },
+        { { 2016, 12, 31, 24, 0, 1 }, NULL },
+        { { 2017, 1, 1 }, "2017-01-01T00:00:00.000000Z" },
+        { { 2017, 1, 1, 0, 0, 1, 0, false, 60 },
+          "2017-01-01T00:00:01.000000+01:00" },
+        { { 2017, 1, 1, 0, 0, 2, 0, true }, "2017-01-01T00:00:02.000000" },
+        { { 12345, 1, 1, 0, 0, 2 }, "+12345-01-01T00:00:02.000000Z" },
+        { { 12345, 1, 1, 0, 0, 3 }, "+12345-01-01T00:00:03.000000Z" },
+        { { 2017, 1, 1, 0, 0, 3 }, "2017-01-01T00:00:03.000000Z" },
+    };
+    iso8601_incremental incremental = {};
+    char buf[64];
+
+    assert(iso8601_formatter_init(ISO8601_FLAG_NONE, 4,
+                                  ISO8601_FORMAT_NORMAL,
+                                  ISO8601_TRUNCATE_NONE, 6,
+                                  &incremental.formatter) == 0);
+
+    for (size_t i = 0; i < sizeof(steps) / sizeof(*steps); i++) {
+        const int ret = steps[i].str ? 0 : EINVAL;
+
+        fprintf(stderr, "incremental: %s\n",
+                steps[i].str ? steps[i].str : "(invalid)");
+        assert(iso8601_incremental_write(&incremental, &steps[i].time,
+                                         sizeof(buf), buf, NULL) == ret);
+        if (ret == 0)
+            assert(strcmp(buf, steps[i].str) == 0);
+    }
+
+    /* A reused prefix still has to fit. */
+    assert(iso8601_incremental_write(&incremental, &steps[0].time, 27, buf,
+                                     NULL) == E2BIG);
+    assert(iso8601_incremental_write(&incremental, &steps[1].time, 27, buf,
+                                     NULL) == E2BIG);
+    assert(iso8601_incremental_write(&incremental, &steps[1].time, 28, buf,
+                                     NULL) == 0);
+    assert(strcmp(buf, steps[1].str) == 0);
+    assert(iso8601_incremental_write(NULL, &steps[1].time, 28, buf,
+                                     NULL) == EINVAL);
+
+    for (int format = ISO8601_FORMAT_NORMAL;
+         format <= ISO8601_FORMAT_ORDINAL; format++) {
+        for (int truncate = ISO8601_TRUNCATE_NONE;
+             truncate <= ISO8601_TRUNCATE_SECOND; truncate++) {
+            test_incremental_walk(ISO8601_FLAG_NONE, format, truncate, 3);
+            test_incremental_walk(ISO8601_FLAG_BASIC, format, truncate, 9);
+            test_incremental_walk(ISO8601_FLAG_TRUSTED, format, truncate, 0);
+        }
+    }
+}
+
+static const struct {
+    iso8601_duration duration;
+    const char *str;
+} durations[] = {
+    { {}, "PT0S" },
+    { { .negative = true }, "-PT0S" },
+    { { 1, 2, 0, 3, 4, 5, 6 }, "P1Y2M3DT4H5M6S" },
+    { { 1, 2, 3, 4, 5, 6, 7 }, "P1Y2M3W4DT5H6M7S" },
+    { { .weeks = 2 }, "P2W" },
+    { { .months = 1 }, "P1M" },
+    { { .minutes = 1 }, "PT1M" },
+    { { .days = 1, .negative = true }, "-P1D" },
+    { { .seconds = 6, .useconds = 500000 }, "PT6.500000S" },
+    { { .useconds = 1 }, "PT0.000001S" },
+    { { .nseconds = 1 }, "PT0.000000001S" },
+    { { .hours = 1, .seconds = 1 }, "PT1H1S" },
+    { { .years = 4294967295 }, "P4294967295Y" },
+    { { .useconds = 1000000 } },
+    { { .nseconds = 1000 } },
+};
+
+static void test_epoch(void)
+{
+    static const struct {
+        int64_t value;
+        iso8601_unit unit;
+        int16_t tzminutes;
+        const char *str;
+        int ret;
+    } epochs[] = {
+        { 0, ISO8601_UNIT_SECOND, 0, "1970-01-01T00:00:00.000Z" },
+        { -500, ISO8601_UNIT_MILLI, 0, "1969-12-31T23:59:59.500Z" },
+        { -1, ISO8601_UNIT_NANO, 0, "1969-12-31T23:59:59.999Z" },
+        { 1719792000, ISO8601_UNIT_SECOND, -300,
+          "2024-06-30T19:00:00.000-05:00" },
+        { 1719792000, ISO8601_UNIT_SECOND, 1440,
+          "2024-07-02T00:00:00.000+24:00" },
+        { 951782400123456, ISO8601_UNIT_MICRO, 90,
+          "2000-02-29T01:30:00.123+01:30" },
+        { INT64_MIN, ISO8601_UNIT_NANO, 0, "1677-09-21T00:12:43.145Z" },
+        { INT64_MAX, ISO8601_UNIT_NANO, 0, "2262-04-11T23:47:16.854Z" },
+        { 253402300799, ISO8601_UNIT_SECOND, 0, "9999-12-31T23:59:59.000Z" },
+        { 253402300800, ISO8601_UNIT_SECOND, 0,
+          "+10000-01-01T00:00:00.000Z" },
+        { -62167219200, ISO8601_UNIT_SECOND, -1,
+          "-0001-12-31T23:59:00.000-00:01" },
+        { 3093527980800, ISO8601_UNIT_SECOND, 0, NULL, ERANGE },
+        { INT64_MAX, ISO8601_UNIT_SECOND, 0, NULL, ERANGE },
+        { INT64_MIN, ISO8601_UNIT_MILLI, 0, NULL, ERANGE },
+        { 0, ISO8601_UNIT_SECOND, 1441, NULL, EINVAL },
+        { 0, ISO8601_UNIT_SECOND, -1441, NULL, EINVAL },
+        { 0, ISO8601_UNIT_NANO + 1, 0, NULL, EINVAL },
+    };
+    static const int16_t zones[] = { -720, -300, 0, 1, 330, 840 };
+    iso8601_formatter formatter;
+    iso8601_formatter nano;
+    uint64_t seed = 1;
+    char expected[64];
+    char buf[64];
+    size_t len;
+
+    assert(iso8601_formatter_init(ISO8601_FLAG_NONE, 4, ISO8601_FORMAT_NORMAL,
+                                  ISO8601_TRUNCATE_NONE, 3, &formatter) == 0);
+    assert(iso8601_formatter_init(ISO8601_FLAG_NONE, 4, ISO8601_FORMAT_NORMAL,
+                                  ISO8601_TRUNCATE_NONE, 9, &nano) == 0);
+
+    for (size_t i = 0; i < sizeof(epochs) / sizeof(*epochs); i++) {
+        fprintf(stderr, "epoch: %s\n",
+                epochs[i].str ? epochs[i].str : "(invalid)");
+        assert(iso8601_unparse_epoch(epochs[i].value, epochs[i].unit,
+                                     epochs[i].tzminutes, &formatter,
+                                     sizeof(buf), buf, &len) == epochs[i].ret);
+        if (epochs[i].str == NULL)
+            continue;
+
+        assert(strcmp(buf, epochs[i].str) == 0);
+        assert(len == strlen(buf));
+    }
+
+    /* Random values round trip, and agree with the C library. */
+    for (int i = 0; i < 100000; i++) {
+        static const int64_t limits[] = {
+            [ISO8601_UNIT_SECOND] = 3000000000000,
+            [ISO8601_UNIT_MILLI] = 3000000000000000,
+            [ISO8601_UNIT_MICRO] = 3000000000000000000,
+            [ISO8601_UNIT_NANO] = INT64_MAX,
+        };
+        const iso8601_unit unit = i % 4;
+        const int16_t zone = zones[i % 6];
+        iso8601_time time;
+        int64_t value;
+        int64_t back;
+
+        seed = seed * 6364136223846793005 + 1442695040888963407;
+        value = (int64_t) (seed >> 1) % limits[unit];
+        if (seed & 1)
+            value = -value;
+
+        assert(iso8601_unparse_epoch(value, unit, zone, &nano, sizeof(buf),
+                                     buf, &len) == 0);
+        assert(len == strlen(buf));
+        assert(iso8601_parse_epoch(buf, len, NULL, unit, NULL, &back) == 0);
+        assert(back == value);
+
+        if (unit != ISO8601_UNIT_MICRO)
+            continue;
+
+        iso8601_from_time_t(value / 1000000 - (value % 1000000 < 0),
+                            (value % 1000000 + 1000000) % 1000000, false,
+                            zone, &time);
+        assert(iso8601_formatter_write(&nano, &time, sizeof(expected),
+                                       expected, NULL) == 0);
+        assert(strcmp(buf, expected) == 0);
+    }
+
+    /* The output must fit with its NUL. */
+    assert(iso8601_unparse_epoch(0, ISO8601_UNIT_SECOND, 0, &formatter, 25,
+                                 buf, &len) == 0);
+    assert(strcmp(buf, "1970-01-01T00:00:00.000Z") == 0);
+    assert(iso8601_unparse_epoch(0, ISO8601_UNIT_SECOND, 0, &formatter, 24,
+                                 buf, NULL) == E2BIG);
+    assert(iso8601_unparse_epoch(0, ISO8601_UNIT_SECOND, 0, &formatter, 0,
+                                 buf, NULL) == E2BIG);
+    assert(iso8601_unparse_epoch(0, ISO8601_UNIT_SECOND, 0, NULL, sizeof(buf),
+                                 buf, NULL) == EINVAL);
+    assert(iso8601_unparse_epoch(0, ISO8601_UNIT_SECOND, 0, &formatter,
+                                 sizeof(buf), NULL, NULL) == EINVAL);
+}
+
+static void test_duration(void)
+{
+    iso8601_duration duration;
+    char buf[128];
+
+    for (size_t i = 0; i < sizeof(durations) / sizeof(*durations); i++) {
+        const int ret = !durations[i].str ? EINVAL : 0;
+
+        fprintf(stderr, "answer: %s\n",
+                durations[i].str ? durations[i].str : "(invalid)");
+        assert(iso8601_unparse_duration(&durations[i].duration,
+                                        sizeof(buf), buf) == ret);
+        if (!durations[i].str)
+            continue;
+
+        fprintf(stderr, "result: %s\n", buf);
+        assert(strcmp(buf, durations[i].str) == 0);
+
+        /* Durations round-trip. */
+        assert(iso8601_parse_duration(buf, SIZE_MAX, NULL, &duration) == 0);
+        assert(memcmp(&duration, &durations[i].duration,
+                      sizeof(duration)) == 0);
+
+        /* Every truncated buffer is reported. */
+        for (size_t j = 0; j <= strlen(durations[i].str); j++)
+            assert(iso8601_unparse_duration(&durations[i].duration, j,
+                                            buf) == E2BIG);
+    }
+
+    assert(iso8601_unparse_duration(NULL, sizeof(buf), buf) == EINVAL);
+    assert(iso8601_unparse_duration(&durations[0].duration, 0,
+                                    NULL) == EINVAL);
+}
+
 int main(int argc, const char **argv)
 {
     assert(iso8601_unparse(NULL, ISO8601_FLAG_NONE, 4, ISO8601_FORMAT_NORMAL, \
@@ -331,10 +834,19 @@ int main(int argc, const char **argv)
         assert(strcmp(buf, tests[i].str) == 0);
     }
 
+    for (size_t i = 0; i < sizeof(tests) / sizeof(*tests); i++)
+        test_formatter(i);
+    test_formatter_precision();
+    test_column();
+    test_incremental();
+    test_epoch();
+
     /* Test all the buffer too small conditions. */
     test_e2big(ISO8601_FORMAT_NORMAL);
     test_e2big(ISO8601_FORMAT_ORDINAL);
     test_e2big(ISO8601_FORMAT_WEEKDATE);
 
+    test_duration();
+
     return 0;
 }
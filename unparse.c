@@ -19,15 +19,37 @@
 #include "iso8601.h"
 #include "internal.h"
 
-#include <stdio.h>
 #include <errno.h>
 #include <string.h>
-#include <stdarg.h>
 
 static bool is_leap_second(const iso8601_time *in)
 {
     return in->month == 12 && in->day == 31 && in->hour == 23 &&
-           in->minute == 59 && in->second == 60 && in->usecond == 0;
+           in->minute == 59 && in->second == 60 && in->usecond == 0 &&
+           in->nsecond == 0;
+}
+
+/* Validate the seconds and their fraction, given valid other fields. */
+static bool validate_seconds(const iso8601_time *in)
+{
+    if (in->hour == 24 && (in->second != 0 ||
+                           in->usecond != 0 ||
+                           in->nsecond != 0))
+        return false;
+
+    if (in->second > 60)
+        return false;
+
+    if (in->second == 60 && !is_leap_second(in))
+        return false;
+
+    if (in->usecond > 999999)
+        return false;
+
+    if (in->nsecond > 999)
+        return false;
+
+    return true;
 }
 
 static bool validate(const iso8601_time *in)
@@ -49,21 +71,13 @@ static bool validate(const iso8601_time *in)
     if (in->hour > 24)
         return false;
 
-    if (in->hour == 24 && (in->minute != 0 ||
-                           in->second != 0 ||
-                           in->usecond != 0))
+    if (in->hour == 24 && in->minute != 0)
         return false;
 
     if (in->minute > 59)
         return false;
 
-    if (in->second > 60)
-        return false;
-
-    if (in->second == 60 && !is_leap_second(in))
-        return false;
-
-    if (in->usecond > 999999)
+    if (!validate_seconds(in))
         return false;
 
     if (!in->localtime && abs(in->tzminutes) > 24 * 60)
@@ -72,139 +86,795 @@ static bool validate(const iso8601_time *in)
     return true;
 }
 
-static bool unparse_year(int32_t year, uint8_t ydigits, size_t len, char *out)
+/* The two digit decimal numbers 00 to 99, back to back. */
+static const char PAIRS[200] =
+    "00010203040506070809" "10111213141516171819"
+    "20212223242526272829" "30313233343536373839"
+    "40414243444546474849" "50515253545556575859"
+    "60616263646566676869" "70717273747576777879"
+    "80818283848586878889" "90919293949596979899";
+
+/* Write a number below 100 as exactly two digits. */
+static char *put2(char *out, uint8_t val)
+{
+    memcpy(out, &PAIRS[val * 2], 2);
+    return out + 2;
+}
+
+/* Write a number with at least width digits, padded with zeros. */
+static char *put_number(char *out, uint64_t val, int width)
+{
+    char *end;
+    char *pos;
+    int digits = 1;
+
+    for (uint64_t tmp = val; tmp >= 10; tmp /= 10)
+        digits++;
+
+    end = pos = out + (digits > width ? digits : width);
+
+    for (; val >= 100; val /= 100) {
+        pos -= 2;
+        memcpy(pos, &PAIRS[val % 100 * 2], 2);
+    }
+
+    if (val >= 10) {
+        pos -= 2;
+        memcpy(pos, &PAIRS[val * 2], 2);
+    } else {
+        *--pos = '0' + val;
+    }
+
+    while (pos > out)
+        *--pos = '0';
+
+    return end;
+}
+
+static char *put_char(char *out, char chr)
 {
-    const char *sign = "";
-    char fmt[] = "%s%0Xd";
-    int ret;
+    *out = chr;
+    return out + 1;
+}
 
-    /* Create the format string. */
-    fmt[4] = '0' + ydigits;
+/* Write an optional separator. */
+static char *put_sep(char *out, bool basic, char sep)
+{
+    return basic ? out : put_char(out, sep);
+}
 
-    /* Figure out the sign. */
+static char *put_year(char *out, int32_t year, uint8_t ydigits)
+{
     if (year < 0)
-        sign = "-";
+        out = put_char(out, '-');
     else if (year > 9999)
-        sign = "+";
+        out = put_char(out, '+');
 
-    ret = snprintf(out, len, fmt, sign, abs(year));
-    return ret >= (ydigits + strlen(sign)) && ret < len;
+    return put_number(out, abs(year), ydigits);
 }
 
-static bool concat(char *out, size_t len, ssize_t chars, const char *fmt, ...)
+/* Copy what was written to buf, up to end, to the output buffer. */
+static int finish(const char *buf, const char *end, size_t len, char *out)
 {
-    size_t size;
-    va_list ap;
-    int ret;
+    const size_t size = end - buf;
 
-    size = strlen(out);
-    len -= size;
+    if (size >= len)
+        return E2BIG;
 
-    va_start(ap, fmt);
-    ret = vsnprintf(out + size, len, fmt, ap);
-    va_end(ap);
+    memcpy(out, buf, size);
+    out[size] = '\0';
+    return 0;
+}
 
-    return ret >= chars && ret < len;
+/* The number of decimal digits to write, or -1 if the flags conflict. */
+static int decimals(const iso8601_time *in, uint32_t flags)
+{
+    switch (flags & (ISO8601_FLAG_MILLI | ISO8601_FLAG_MICRO |
+                     ISO8601_FLAG_NANO)) {
+    case ISO8601_FLAG_MILLI:
+        return 3;
+    case ISO8601_FLAG_MICRO:
+        return 6;
+    case ISO8601_FLAG_NANO:
+        return 9;
+    case 0:
+        return in->nsecond != 0 ? 9 : in->usecond != 0 ? 6 : 0;
+    default:
+        return -1;
+    }
 }
 
-int iso8601_unparse(const iso8601_time *in, uint32_t flags, uint8_t ydigits,
-                    iso8601_format format, iso8601_truncate truncate,
-                    size_t len, char *out)
+/* Write a number with exactly width digits, which it must fit in. */
+static char *put_fixed(char *out, uint32_t val, int width)
+{
+    for (int i = width; i >= 2; i -= 2) {
+        memcpy(&out[i - 2], &PAIRS[val % 100 * 2], 2);
+        val /= 100;
+    }
+
+    if (width % 2 != 0)
+        out[0] = '0' + val;
+
+    return out + width;
+}
+
+/* The fraction of a second, truncated to the given number of digits. */
+static uint32_t fraction(const iso8601_time *in, int digits)
+{
+    static const uint32_t scale[] = {
+        1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100,
+        10, 1
+    };
+
+    /* Avoid dividing by a variable in the common cases. */
+    switch (digits) {
+    case 3:
+        return in->usecond / 1000;
+    case 6:
+        return in->usecond;
+    case 9:
+        return in->usecond * 1000 + in->nsecond;
+    default:
+        return (in->usecond * 1000 + in->nsecond) / scale[digits];
+    }
+}
+
+static char *put_fraction(char *out, const iso8601_time *in, int digits)
+{
+    return put_fixed(out, fraction(in, digits), digits);
+}
+
+static char *put_zone(char *out, const iso8601_time *in, bool basic)
+{
+    if (in->localtime)
+        return out;
+
+    if (in->tzminutes == 0)
+        return put_char(out, 'Z');
+
+    out = put_char(out, in->tzminutes > 0 ? '+' : '-');
+    out = put2(out, abs(in->tzminutes) / 60);
+    if (!basic || in->tzminutes % 60 != 0)
+        out = put2(put_sep(out, basic, ':'), abs(in->tzminutes) % 60);
+
+    return out;
+}
+
+/*
+ * Write a valid time with the given settings, without a NUL. Returns the end
+ * of the output, or NULL if the date can't be converted to the format.
+ */
+static char *write_time(const iso8601_time *in, bool basic, uint8_t ydigits,
+                        iso8601_format format, iso8601_truncate truncate,
+                        int digits, char *pos)
 {
-    const bool basic = (flags & ISO8601_FLAG_BASIC) && ydigits == 4;
-    const char *tsep = basic ? "" : ":";
-    const char *dsep = basic ? "" : "-";
     uint16_t ordinal;
     int32_t year;
     uint8_t week;
     uint8_t day;
 
+    /* Write the date. */
+    pos = put_year(pos, in->year, ydigits);
+    if (truncate == ISO8601_TRUNCATE_YEAR)
+        return pos;
+    switch (format) {
+    case ISO8601_FORMAT_NORMAL:
+        pos = put2(put_sep(pos, basic, '-'), in->month);
+        if (truncate == ISO8601_TRUNCATE_MONTH)
+            return pos;
+
+        pos = put2(put_sep(pos, basic, '-'), in->day);
+        break;
+
+    case ISO8601_FORMAT_WEEKDATE:
+        if (!weekdate_from_date(in->year, in->month, in->day,
+                                &year, &week, &day))
+            return NULL;
+
+        pos = put2(put_char(put_sep(pos, basic, '-'), 'W'), week);
+        if (truncate == ISO8601_TRUNCATE_WEEK)
+            return pos;
+
+        pos = put_char(put_sep(pos, basic, '-'), '0' + day);
+        break;
+
+    case ISO8601_FORMAT_ORDINAL:
+        if (!ordinal_from_date(in->year, in->month, in->day, &ordinal))
+            return NULL;
+
+        pos = put_number(put_sep(pos, basic, '-'), ordinal, 3);
+        if (truncate == ISO8601_TRUNCATE_MONTH)
+            return pos;
+        break;
+    }
+    if (truncate == ISO8601_TRUNCATE_DAY)
+        return pos;
+
+    /* Write the time. */
+    pos = put2(put_char(pos, 'T'), in->hour);
+    if (truncate != ISO8601_TRUNCATE_HOUR) {
+        pos = put2(put_sep(pos, basic, ':'), in->minute);
+        if (truncate != ISO8601_TRUNCATE_MINUTE) {
+            pos = put2(put_sep(pos, basic, ':'), in->second);
+            if (truncate != ISO8601_TRUNCATE_SECOND && digits > 0)
+                pos = put_fraction(put_char(pos, '.'), in, digits);
+        }
+    }
+
+    /* Write the timezone. */
+    return put_zone(pos, in, basic);
+}
+
+int iso8601_unparse(const iso8601_time *in, uint32_t flags, uint8_t ydigits,
+                    iso8601_format format, iso8601_truncate truncate,
+                    size_t len, char *out)
+{
+    const bool basic = (flags & ISO8601_FLAG_BASIC) && ydigits == 4;
+    char buf[64];
+    char *end;
+    int digits;
+
     /* Validate input. */
     if (!validate(in))
         return EINVAL;
-    if (out == NULL)
+    digits = decimals(in, flags);
+    if (out == NULL || digits < 0)
         return EINVAL;
     if (len < 1)
         return E2BIG;
     out[0] = '\0';
 
-    /* Write the date. */
     if (ydigits < 2 || ydigits > 9)
         return EINVAL;
-    if (!unparse_year(in->year, ydigits, len, out))
-        return E2BIG;
+
+    end = write_time(in, basic, ydigits, format, truncate, digits, buf);
+    if (end == NULL)
+        return EINVAL;
+
+    return finish(buf, end, len, out);
+}
+
+/* Fill in n bytes of the pattern with zeros, as a field at offset. */
+static int8_t add_field(iso8601_formatter *formatter, uint8_t n)
+{
+    const int8_t offset = formatter->len;
+
+    memset(&formatter->pattern[offset], '0', n);
+    formatter->len += n;
+    return offset;
+}
+
+static void add_char(iso8601_formatter *formatter, char chr)
+{
+    formatter->pattern[formatter->len++] = chr;
+}
+
+static void add_sep(iso8601_formatter *formatter, char sep)
+{
+    if (!(formatter->flags & ISO8601_FLAG_BASIC))
+        add_char(formatter, sep);
+}
+
+int iso8601_formatter_init(uint32_t flags, uint8_t ydigits,
+                           iso8601_format format, iso8601_truncate truncate,
+                           uint8_t precision, iso8601_formatter *out)
+{
+    iso8601_formatter f = {
+        .ydigits = ydigits, .precision = precision, .format = format,
+        .truncate = truncate, .month = -1, .day = -1, .week = -1,
+        .wday = -1, .ordinal = -1, .hour = -1, .minute = -1, .second = -1,
+        .fraction = -1,
+    };
+
+    if (out == NULL || ydigits < 2 || ydigits > 9 || precision > 9)
+        return EINVAL;
+    if (flags & ~(ISO8601_FLAG_BASIC | ISO8601_FLAG_TRUSTED))
+        return EINVAL;
+    if ((unsigned) format > ISO8601_FORMAT_ORDINAL ||
+        (unsigned) truncate > ISO8601_TRUNCATE_SECOND)
+        return EINVAL;
+
+    /* As with iso8601_unparse(), only four digit years may be basic. */
+    f.flags = ydigits == 4 ? flags : flags & ~ISO8601_FLAG_BASIC;
+
+    add_field(&f, ydigits);
     if (truncate == ISO8601_TRUNCATE_YEAR)
-        return 0;
+        goto done;
     switch (format) {
     case ISO8601_FORMAT_NORMAL:
-        if (!concat(out, len, basic ? 2 : 3, "%s%02hhu", dsep, in->month))
-            return E2BIG;
+        add_sep(&f, '-');
+        f.month = add_field(&f, 2);
         if (truncate == ISO8601_TRUNCATE_MONTH)
-            return 0;
+            goto done;
 
-        if (!concat(out, len, basic ? 2 : 3, "%s%02hhu", dsep, in->day))
-            return E2BIG;
+        add_sep(&f, '-');
+        f.day = add_field(&f, 2);
         break;
 
     case ISO8601_FORMAT_WEEKDATE:
-        if (!weekdate_from_date(in->year, in->month, in->day,
-                                &year, &week, &day))
-            return EINVAL;
-
-        if (!concat(out, len, basic ? 3 : 4, "%sW%02hhu", dsep, week))
-            return E2BIG;
+        add_sep(&f, '-');
+        add_char(&f, 'W');
+        f.week = add_field(&f, 2);
         if (truncate == ISO8601_TRUNCATE_WEEK)
-            return 0;
+            goto done;
 
-        if (!concat(out, len, basic ? 1 :2, "%s%hhu", dsep, day))
-            return E2BIG;
+        add_sep(&f, '-');
+        f.wday = add_field(&f, 1);
         break;
 
     case ISO8601_FORMAT_ORDINAL:
-        if (!ordinal_from_date(in->year, in->month, in->day, &ordinal))
-            return EINVAL;
-
-        if (!concat(out, len, basic ? 3 : 4, "%s%03hu", dsep, ordinal))
-            return E2BIG;
-        if (truncate == ISO8601_TRUNCATE_MONTH)
-            return 0;
+        add_sep(&f, '-');
+        f.ordinal = add_field(&f, 3);
+        if (truncate == ISO8601_TRUNCATE_ORDINAL)
+            goto done;
         break;
     }
     if (truncate == ISO8601_TRUNCATE_DAY)
+        goto done;
+
+    add_char(&f, 'T');
+    f.hour = add_field(&f, 2);
+    if (truncate == ISO8601_TRUNCATE_HOUR)
+        goto done;
+
+    add_sep(&f, ':');
+    f.minute = add_field(&f, 2);
+    if (truncate == ISO8601_TRUNCATE_MINUTE)
+        goto done;
+
+    add_sep(&f, ':');
+    f.second = add_field(&f, 2);
+    if (truncate == ISO8601_TRUNCATE_SECOND || precision == 0)
+        goto done;
+
+    add_char(&f, '.');
+    f.fraction = add_field(&f, precision);
+
+done:
+    *out = f;
+    return 0;
+}
+
+/* Fill the variable fields into a copy of the pattern. */
+static char *fill(const iso8601_formatter *f, const iso8601_time *in,
+                  char *out)
+{
+    uint16_t ordinal;
+    int32_t year;
+    uint8_t week;
+    uint8_t day;
+
+    memcpy(out, f->pattern, sizeof(f->pattern));
+    put_fixed(out, in->year, f->ydigits);
+
+    if (f->month >= 0)
+        put2(&out[f->month], in->month);
+    if (f->day >= 0)
+        put2(&out[f->day], in->day);
+
+    if (f->week >= 0) {
+        if (!weekdate_from_date(in->year, in->month, in->day,
+                                &year, &week, &day))
+            return NULL;
+
+        put2(&out[f->week], week);
+        if (f->wday >= 0)
+            out[f->wday] = '0' + day;
+    }
+
+    if (f->ordinal >= 0) {
+        if (!ordinal_from_date(in->year, in->month, in->day, &ordinal))
+            return NULL;
+
+        put_fixed(&out[f->ordinal], ordinal, 3);
+    }
+
+    if (f->hour >= 0)
+        put2(&out[f->hour], in->hour);
+    if (f->minute >= 0)
+        put2(&out[f->minute], in->minute);
+    if (f->second >= 0)
+        put2(&out[f->second], in->second);
+    if (f->fraction >= 0)
+        put_fraction(&out[f->fraction], in, f->precision);
+
+    /* Dates are written without a timezone. */
+    if (f->hour < 0)
+        return &out[f->len];
+
+    return put_zone(&out[f->len], in, f->flags & ISO8601_FLAG_BASIC);
+}
+
+/* Whether the year fits in the pattern, unsigned and in ydigits digits. */
+static bool fits(const iso8601_formatter *f, int32_t year)
+{
+    static const int32_t limits[] = {
+        [2] = 100, [3] = 1000, [4] = 10000, [5] = 10000, [6] = 10000,
+        [7] = 10000, [8] = 10000, [9] = 10000
+    };
+
+    return year >= 0 && year < limits[f->ydigits];
+}
+
+/*
+ * Write a valid time with a formatter, without a NUL. There must be room for
+ * ISO8601_FORMATTER_MAX bytes, since the whole pattern is copied. Returns
+ * the end of the output.
+ */
+static char *emit(const iso8601_formatter *f, const iso8601_time *in,
+                  char *out)
+{
+    if (!fits(f, in->year)) {
+        return write_time(in, f->flags & ISO8601_FLAG_BASIC, f->ydigits,
+                          f->format, f->truncate, f->precision, out);
+    }
+
+    return fill(f, in, out);
+}
+
+/* Like emit(), but returns NULL if the time is invalid. */
+static char *render(const iso8601_formatter *f, const iso8601_time *in,
+                    char *out)
+{
+    if (!(f->flags & ISO8601_FLAG_TRUSTED) && !validate(in))
+        return NULL;
+
+    return emit(f, in, out);
+}
+
+/*
+ * Write a time with a formatter at data[*pos], without a NUL, and move *pos
+ * past it. Writes straight into data when it's certain to fit.
+ */
+static int render_into(const iso8601_formatter *f, const iso8601_time *in,
+                       char *data, size_t len, size_t *pos)
+{
+    char buf[ISO8601_FORMATTER_MAX];
+    char *end;
+
+    if (len - *pos >= sizeof(buf)) {
+        end = render(f, in, &data[*pos]);
+        if (end == NULL)
+            return EINVAL;
+
+        *pos = end - data;
         return 0;
+    }
 
-    /* Write the time. */
-    if (!concat(out, len, 3, "T%02hhu", in->hour))
+    end = render(f, in, buf);
+    if (end == NULL)
+        return EINVAL;
+    if (end - buf > len - *pos)
         return E2BIG;
-    if (truncate != ISO8601_TRUNCATE_HOUR) {
-        if (!concat(out, len, basic ? 2 : 3, "%s%02hhu", tsep, in->minute))
+
+    memcpy(&data[*pos], buf, end - buf);
+    *pos += end - buf;
+    return 0;
+}
+
+int iso8601_formatter_write(const iso8601_formatter *formatter,
+                            const iso8601_time *in, size_t len, char *out,
+                            size_t *written)
+{
+    size_t pos = 0;
+    int err;
+
+    if (formatter == NULL || in == NULL || out == NULL)
+        return EINVAL;
+    if (len < 1) {
+        if (!(formatter->flags & ISO8601_FLAG_TRUSTED) && !validate(in))
+            return EINVAL;
+        return E2BIG;
+    }
+
+    /* Leave room for the NUL. */
+    err = render_into(formatter, in, out, len - 1, &pos);
+    if (err != 0)
+        return err;
+
+    out[pos] = '\0';
+    if (written != NULL)
+        *written = pos;
+
+    return 0;
+}
+
+int iso8601_unparse_column32(const iso8601_formatter *formatter,
+                             const iso8601_time *in, size_t n, char *data,
+                             size_t len, int32_t *offsets, int *status)
+{
+    size_t pos = 0;
+    int ret = 0;
+
+    if (formatter == NULL || offsets == NULL ||
+        (n > 0 && (in == NULL || data == NULL)))
+        return EINVAL;
+
+    /* Every offset must fit. */
+    if (len > INT32_MAX)
+        len = INT32_MAX;
+
+    offsets[0] = 0;
+    for (size_t i = 0; i < n; i++) {
+        int err = render_into(formatter, &in[i], data, len, &pos);
+        if (status != NULL)
+            status[i] = err;
+        if (err == E2BIG)
             return E2BIG;
-        if (truncate != ISO8601_TRUNCATE_MINUTE) {
-            if (!concat(out, len, basic ? 2 : 3, "%s%02hhu", tsep, in->second))
-                return E2BIG;
-            if (truncate != ISO8601_TRUNCATE_SECOND && in->usecond != 0) {
-                if (!concat(out, len, 7, ".%06u", in->usecond))
-                    return E2BIG;
-            }
+        if (err != 0)
+            ret = EINVAL;
+
+        offsets[i + 1] = pos;
+    }
+
+    return ret;
+}
+
+int iso8601_unparse_column64(const iso8601_formatter *formatter,
+                             const iso8601_time *in, size_t n, char *data,
+                             size_t len, int64_t *offsets, int *status)
+{
+    size_t pos = 0;
+    int ret = 0;
+
+    if (formatter == NULL || offsets == NULL ||
+        (n > 0 && (in == NULL || data == NULL)))
+        return EINVAL;
+
+    /* Every offset must fit. */
+    if (len > INT64_MAX)
+        len = INT64_MAX;
+
+    offsets[0] = 0;
+    for (size_t i = 0; i < n; i++) {
+        int err = render_into(formatter, &in[i], data, len, &pos);
+        if (status != NULL)
+            status[i] = err;
+        if (err == E2BIG)
+            return E2BIG;
+        if (err != 0)
+            ret = EINVAL;
+
+        offsets[i + 1] = pos;
+    }
+
+    return ret;
+}
+
+int iso8601_unparse_fixed(const iso8601_formatter *formatter,
+                          const iso8601_time *in, size_t n, size_t width,
+                          char *data, int *status)
+{
+    int ret = 0;
+
+    if (formatter == NULL || (n > 0 && (in == NULL || data == NULL)))
+        return EINVAL;
+
+    for (size_t i = 0; i < n; i++) {
+        char *slot = &data[i * width];
+        size_t pos = 0;
+        int err;
+
+        err = render_into(formatter, &in[i], slot, width, &pos);
+        if (err == 0 && pos != width)
+            err = EINVAL;
+        if (status != NULL)
+            status[i] = err;
+        if (err != 0) {
+            memset(slot, 0, width);
+            ret = EINVAL;
         }
     }
 
-    /* Write the timezone. */
-    if (in->localtime)
+    return ret;
+}
+
+/* Whether two times differ at most in their seconds and fraction. */
+static bool same_minute(const iso8601_time *a, const iso8601_time *b)
+{
+    return a->minute == b->minute && a->hour == b->hour &&
+           a->day == b->day && a->month == b->month && a->year == b->year &&
+           a->localtime == b->localtime && a->tzminutes == b->tzminutes;
+}
+
+int iso8601_incremental_write(iso8601_incremental *incremental,
+                              const iso8601_time *in, size_t len, char *out,
+                              size_t *written)
+{
+    const iso8601_formatter *f;
+    char *end;
+
+    if (incremental == NULL || in == NULL || out == NULL)
+        return EINVAL;
+    f = &incremental->formatter;
+
+    /* In the same minute, only the seconds and the fraction change. */
+    if (incremental->cached && same_minute(&incremental->last, in)) {
+        if (!(f->flags & ISO8601_FLAG_TRUSTED) && !validate_seconds(in))
+            return EINVAL;
+        if (incremental->len >= len)
+            return E2BIG;
+
+        /* A copy of constant size is much cheaper when there's room. */
+        if (len >= sizeof(incremental->buf))
+            memcpy(out, incremental->buf, sizeof(incremental->buf));
+        else
+            memcpy(out, incremental->buf, incremental->len + 1);
+        if (f->second >= 0)
+            put2(&out[f->second], in->second);
+        if (f->fraction >= 0)
+            put_fraction(&out[f->fraction], in, f->precision);
+
+        if (written != NULL)
+            *written = incremental->len;
         return 0;
+    }
 
-    if (in->tzminutes == 0)
-        return concat(out, len, 1, "%s", "Z") ? 0 : E2BIG;
+    /* Otherwise, write the time in full and remember it. */
+    end = render(f, in, incremental->buf);
+    if (end == NULL) {
+        incremental->cached = false;
+        return EINVAL;
+    }
 
-    if (!concat(out, len, 3, "%s%02hhu",
-                in->tzminutes > 0 ? "+" : "-",
-                abs(in->tzminutes) / 60))
+    *end = '\0';
+    incremental->last = *in;
+    incremental->len = end - incremental->buf;
+    incremental->cached = fits(f, in->year);
+
+    if (incremental->len >= len)
         return E2BIG;
-    if (!basic || in->tzminutes % 60 != 0) {
-        if (!concat(out, len, basic ? 2 : 3, "%s%02hhu",
-                    tsep, abs(in->tzminutes) % 60))
-            return E2BIG;
+
+    memcpy(out, incremental->buf, incremental->len + 1);
+    if (written != NULL)
+        *written = incremental->len;
+    return 0;
+}
+
+int iso8601_unparse_epoch(int64_t value, iso8601_unit unit,
+                          int16_t tzminutes,
+                          const iso8601_formatter *formatter, size_t len,
+                          char *out, size_t *written)
+{
+    char buf[ISO8601_FORMATTER_MAX];
+    iso8601_time time = { .tzminutes = tzminutes };
+    int64_t fraction = 0;
+    int64_t seconds;
+    int64_t days;
+    char *end;
+    int err;
+
+    if ((unsigned) unit > ISO8601_UNIT_NANO || abs(tzminutes) > 24 * 60 ||
+        formatter == NULL || out == NULL)
+        return EINVAL;
+
+    /*
+     * Split the value into days, seconds of the day and nanoseconds. Each
+     * case divides by a constant, which compiles to a multiplication.
+     */
+    switch (unit) {
+    case ISO8601_UNIT_SECOND:
+        seconds = value;
+        break;
+    case ISO8601_UNIT_MILLI:
+        seconds = floor_div(value, 1000, &fraction);
+        fraction *= 1000000;
+        break;
+    case ISO8601_UNIT_MICRO:
+        seconds = floor_div(value, 1000000, &fraction);
+        fraction *= 1000;
+        break;
+    case ISO8601_UNIT_NANO:
+    default:
+        seconds = floor_div(value, 1000000000, &fraction);
+        break;
+    }
+    days = floor_div(seconds, 86400, &seconds);
+
+    /* Move to the wall clock at the offset, which is at most a day away. */
+    seconds += tzminutes * 60;
+    if (seconds < 0) {
+        seconds += 86400;
+        days--;
+    } else if (seconds >= 86400) {
+        seconds -= 86400;
+        days++;
+    }
+
+    if (!civil_from_days(days, &time.year, &time.month, &time.day) ||
+        time.year < -99999 || time.year > 99999)
+        return ERANGE;
+
+    time.hour = seconds / 3600;
+    time.minute = seconds / 60 % 60;
+    time.second = seconds % 60;
+    time.usecond = fraction / 1000;
+    time.nsecond = fraction % 1000;
+
+    /* The time is valid by construction, so it needn't be checked. */
+    if (len > sizeof(buf)) {
+        end = emit(formatter, &time, out);
+        *end = '\0';
+    } else {
+        end = emit(formatter, &time, buf);
+        err = finish(buf, end, len, out);
+        if (err != 0)
+            return err;
+
+        end = &out[end - buf];
     }
 
+    if (written != NULL)
+        *written = end - out;
     return 0;
 }
+
+/* Write a component of a duration, such as 12Y. */
+static char *put_component(char *out, uint32_t val, char designator)
+{
+    return put_char(put_number(out, val, 1), designator);
+}
+
+int iso8601_unparse_duration(const iso8601_duration *in, size_t len,
+                             char *out)
+{
+    char buf[128];
+    char *pos = buf;
+    char *date;
+    bool time;
+    int digits;
+
+    /* Validate input. */
+    if (in == NULL || out == NULL)
+        return EINVAL;
+    if (in->useconds > 999999 || in->nseconds > 999)
+        return EINVAL;
+    if (len < 1)
+        return E2BIG;
+    out[0] = '\0';
+
+    digits = in->nseconds != 0 ? 9 : in->useconds != 0 ? 6 : 0;
+    time = in->hours != 0 || in->minutes != 0 || in->seconds != 0 ||
+           digits > 0;
+
+    if (in->negative)
+        pos = put_char(pos, '-');
+    pos = date = put_char(pos, 'P');
+
+    /* Write the date components. */
+    if (in->years != 0)
+        pos = put_component(pos, in->years, 'Y');
+    if (in->months != 0)
+        pos = put_component(pos, in->months, 'M');
+    if (in->weeks != 0)
+        pos = put_component(pos, in->weeks, 'W');
+    if (in->days != 0)
+        pos = put_component(pos, in->days, 'D');
+
+    /* A zero duration still needs one component. */
+    if (!time) {
+        if (pos == date)
+            pos = put_component(put_char(pos, 'T'), 0, 'S');
+        return finish(buf, pos, len, out);
+    }
+
+    /* Write the time components. */
+    pos = put_char(pos, 'T');
+    if (in->hours != 0)
+        pos = put_component(pos, in->hours, 'H');
+    if (in->minutes != 0)
+        pos = put_component(pos, in->minutes, 'M');
+    if (in->seconds == 0 && digits == 0)
+        return finish(buf, pos, len, out);
+
+    pos = put_number(pos, in->seconds, 1);
+    if (digits > 0) {
+        uint64_t fraction = (uint64_t) in->useconds * 1000 + in->nseconds;
+        if (digits == 6)
+            fraction /= 1000;
+
+        pos = put_number(put_char(pos, '.'), fraction, digits);
+    }
+
+    return finish(buf, put_char(pos, 'S'), len, out);
+}